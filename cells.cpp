@@ -0,0 +1,451 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <string.h>
+#include <stdlib.h>
+#include <algorithm>
+
+using namespace std;
+
+// How the colors of a cell should be interpreted
+const uint8_t CELL_COLOR_DEFAULT = 0; // Use whatever colors the terminal defaults to
+const uint8_t CELL_COLOR_BASIC = 1; // fg[0] and bg[0] are one of the 8 basic ANSI colors
+const uint8_t CELL_COLOR_256 = 2; // fg[0] and bg[0] are indexes into the 256 color palette
+const uint8_t CELL_COLOR_RGB = 3; // fg and bg are full colors, stored as BGR like opencv does
+
+// A single character on the screen, along with its colors
+struct Cell {
+	char glyph[4]; // A UTF-8 character, padded with zeros so cells can be compared with memcmp
+	uint8_t colorType;
+	uint8_t fg[3];
+	uint8_t bg[3];
+	uint8_t shade; // How bright the glyph itself looks, 0-255, in modes that draw with glyphs instead of colors
+	uint8_t overlay; // Set for cells drawn by the overlay rather than the video
+};
+
+// Setting the glyph starts the cell over, so shade and overlay have to be set after it
+inline void setCellGlyph(Cell& cell, const char* glyph) {
+	memset(cell.glyph, 0, sizeof(cell.glyph));
+	strncpy(cell.glyph, glyph, sizeof(cell.glyph) - 1);
+	cell.shade = 0;
+	cell.overlay = 0;
+}
+
+inline void setCellGlyph(Cell& cell, char glyph) {
+	memset(cell.glyph, 0, sizeof(cell.glyph));
+	cell.glyph[0] = glyph;
+	cell.shade = 0;
+	cell.overlay = 0;
+}
+
+inline void setCellShade(Cell& cell, uint8_t shade) {
+	cell.shade = shade;
+}
+
+inline void setCellDefault(Cell& cell) {
+	cell.colorType = CELL_COLOR_DEFAULT;
+	memset(cell.fg, 0, 3);
+	memset(cell.bg, 0, 3);
+}
+
+inline void setCellBasic(Cell& cell, uint8_t fg, uint8_t bg) {
+	cell.colorType = CELL_COLOR_BASIC;
+	memset(cell.fg, 0, 3);
+	memset(cell.bg, 0, 3);
+	cell.fg[0] = fg;
+	cell.bg[0] = bg;
+}
+
+inline void setCell256(Cell& cell, uint8_t fg, uint8_t bg) {
+	cell.colorType = CELL_COLOR_256;
+	memset(cell.fg, 0, 3);
+	memset(cell.bg, 0, 3);
+	cell.fg[0] = fg;
+	cell.bg[0] = bg;
+}
+
+inline void setCellRGB(Cell& cell, const uint8_t* fg, const uint8_t* bg) {
+	cell.colorType = CELL_COLOR_RGB;
+	memcpy(cell.fg, fg, 3);
+	memcpy(cell.bg, bg, 3);
+}
+
+inline bool cellsEqual(const Cell& a, const Cell& b) {
+	return memcmp(&a, &b, sizeof(Cell)) == 0;
+}
+
+// A full screen worth of cells
+class CellGrid {
+	public:
+		int rows;
+		int cols;
+		vector<Cell> cells;
+
+		CellGrid(int rows, int cols) {
+			this->rows = rows;
+			this->cols = cols;
+			this->cells.resize(rows * cols);
+			clear();
+		};
+
+		Cell& at(int i, int j) {
+			return cells[i * cols + j];
+		};
+
+		const Cell& at(int i, int j) const {
+			return cells[i * cols + j];
+		};
+
+		// Blank out every cell with a space in the terminal's default colors
+		void clear() {
+			for (Cell& cell : cells) {
+				setCellGlyph(cell, ' ');
+				setCellDefault(cell);
+			}
+		};
+};
+
+// A run of columns [left, right) in one row of a grid
+// A region of a grid is given as one span per row; rows with an empty span aren't part of it
+struct CellSpan {
+	int left;
+	int right;
+};
+
+// Copies the cells inside region from one grid to another of the same size
+void copyCells(const CellGrid& from, CellGrid& to, const vector<CellSpan>& region) {
+	for (int i = 0; i < from.rows; ++i) {
+		if (region[i].right <= region[i].left)	continue;
+
+		int start = i * from.cols + region[i].left;
+		copy(from.cells.begin() + start, from.cells.begin() + start + (region[i].right - region[i].left), to.cells.begin() + start);
+	}
+}
+
+// Whether two grids of the same size match everywhere outside region
+bool cellsEqualOutside(const CellGrid& a, const CellGrid& b, const vector<CellSpan>& region) {
+	for (int i = 0; i < a.rows; ++i) {
+		for (int j = 0; j < a.cols; ++j) {
+			if (j >= region[i].left && j < region[i].right)	continue;
+			if (!cellsEqual(a.at(i, j), b.at(i, j)))	return false;
+		}
+	}
+	return true;
+}
+
+// Appends a small non-negative number without going through a stringstream
+inline void appendNumber(string& out, int number) {
+	char digits[12];
+	int length = 0;
+	do {
+		digits[length++] = '0' + (number % 10);
+		number /= 10;
+	} while (number > 0);
+
+	while (length > 0) {
+		out += digits[--length];
+	}
+}
+
+inline void appendColor(string& out, uint8_t colorType, const uint8_t* color, bool background) {
+	if (colorType == CELL_COLOR_BASIC) {
+		out += background ? "\033[4" : "\033[3";
+		appendNumber(out, color[0]);
+		out += "m";
+	} else if (colorType == CELL_COLOR_256) {
+		out += background ? "\033[48;5;" : "\033[38;5;";
+		appendNumber(out, color[0]);
+		out += "m";
+	} else {
+		out += background ? "\033[48;2;" : "\033[38;2;";
+		appendNumber(out, color[2]);
+		out += ";";
+		appendNumber(out, color[1]);
+		out += ";";
+		appendNumber(out, color[0]);
+		out += "m";
+	}
+}
+
+// Keeps track of where the cursor is and which colors are active while encoding, so neither is resent needlessly
+class CellEncoder {
+	public:
+		string* out;
+		int cols;
+		int cursorRow;
+		int cursorCol;
+		uint8_t colorType;
+		uint8_t fg[3];
+		uint8_t bg[3];
+		bool fgSet;
+
+		// Frames always begin with the colors reset and the cursor in an unknown place
+		CellEncoder(string& out, int cols) {
+			this->out = &out;
+			this->cols = cols;
+			this->cursorRow = -1;
+			this->cursorCol = -1;
+			this->colorType = CELL_COLOR_DEFAULT;
+			this->fgSet = false;
+		};
+
+		void writeCell(int i, int j, const Cell& cell) {
+			// Move the cursor if it isn't already there
+			if (cursorRow == i && cursorCol < j) {
+				if (j - cursorCol == 1) {
+					*out += "\033[C";
+				} else {
+					*out += "\033[";
+					appendNumber(*out, j - cursorCol);
+					*out += "C";
+				}
+			} else if (cursorRow != i || cursorCol != j) {
+				*out += "\033[";
+				appendNumber(*out, i + 1);
+				*out += ";";
+				appendNumber(*out, j + 1);
+				*out += "H";
+			}
+
+			// A space only shows its background, so the foreground color can stay as it is
+			bool needsFg = !(cell.glyph[0] == ' ' && cell.glyph[1] == 0);
+
+			if (cell.colorType == CELL_COLOR_DEFAULT) {
+				if (colorType != CELL_COLOR_DEFAULT) {
+					*out += "\033[0m";
+					colorType = CELL_COLOR_DEFAULT;
+				}
+			} else {
+				bool typeChanged = colorType != cell.colorType;
+				if (typeChanged) {
+					colorType = cell.colorType;
+					fgSet = false;
+				}
+				if (typeChanged || memcmp(bg, cell.bg, 3) != 0) {
+					appendColor(*out, cell.colorType, cell.bg, true);
+					memcpy(bg, cell.bg, 3);
+				}
+				if (needsFg && (!fgSet || memcmp(fg, cell.fg, 3) != 0)) {
+					appendColor(*out, cell.colorType, cell.fg, false);
+					memcpy(fg, cell.fg, 3);
+					fgSet = true;
+				}
+			}
+
+			// An empty glyph would print nothing while the cursor is still counted as moving on, so show a space instead
+			if (cell.glyph[0] == 0) {
+				*out += ' ';
+			} else {
+				*out += cell.glyph;
+			}
+
+			// Printing in the last column leaves the cursor waiting to wrap, so its position can't be trusted anymore
+			if (j + 1 >= cols) {
+				cursorRow = -1;
+				cursorCol = -1;
+			} else {
+				cursorRow = i;
+				cursorCol = j + 1;
+			}
+		};
+};
+
+// Appends the escape codes needed to turn what the terminal is showing (shown) into frame, then updates shown to match
+// Only cells that actually changed are written, unless forceAll is set
+// If region is given, only the cells inside it are looked at; everything else is taken to be showing already
+void encodeCells(const CellGrid& frame, CellGrid& shown, bool forceAll, string& out, const vector<CellSpan>* region = nullptr) {
+	out += "\033[?25l"; // Makes the cursor not blink for better looking text rendering
+
+	CellEncoder encoder(out, frame.cols);
+
+	for (int i = 0; i < frame.rows; ++i) {
+		int left = region ? (*region)[i].left : 0;
+		int right = region ? (*region)[i].right : frame.cols;
+
+		for (int j = left; j < right; ++j) {
+			const Cell& cell = frame.at(i, j);
+			Cell& shownCell = shown.at(i, j);
+
+			if (!forceAll && cellsEqual(cell, shownCell)) {
+				continue;
+			}
+
+			encoder.writeCell(i, j, cell);
+			shownCell = cell;
+		}
+	}
+
+	// Reset the color
+	out += "\033[0m";
+}
+
+// Levels used by the 6x6x6 color cube of the 256 color palette
+const uint8_t PALETTE_CUBE_LEVELS[] = {0, 95, 135, 175, 215, 255};
+
+// Colors of the 8 basic ANSI colors, as BGR
+const uint8_t BASIC_COLORS[8][3] = {
+	{0, 0, 0}, {0, 0, 205}, {0, 205, 0}, {0, 205, 205},
+	{238, 0, 0}, {205, 0, 205}, {205, 205, 0}, {229, 229, 229}
+};
+
+// Gets the color a cell would show on a typical terminal, as BGR
+inline void cellColorBGR(const Cell& cell, bool background, uint8_t* bgr) {
+	const uint8_t* color = background ? cell.bg : cell.fg;
+
+	if (cell.colorType == CELL_COLOR_RGB) {
+		memcpy(bgr, color, 3);
+	} else if (cell.colorType == CELL_COLOR_256) {
+		int index = color[0];
+		if (index >= 232) {
+			bgr[0] = bgr[1] = bgr[2] = 8 + (index - 232) * 10;
+		} else if (index >= 16) {
+			index -= 16;
+			bgr[2] = PALETTE_CUBE_LEVELS[index / 36];
+			bgr[1] = PALETTE_CUBE_LEVELS[(index / 6) % 6];
+			bgr[0] = PALETTE_CUBE_LEVELS[index % 6];
+		} else {
+			memcpy(bgr, BASIC_COLORS[index % 8], 3);
+		}
+	} else if (cell.colorType == CELL_COLOR_BASIC) {
+		memcpy(bgr, BASIC_COLORS[color[0] % 8], 3);
+	} else {
+		// Most terminals default to light text on a dark background
+		memcpy(bgr, BASIC_COLORS[background ? 0 : 7], 3);
+	}
+}
+
+// Roughly how different two cells look, weighted towards green like the eye is
+// Cells drawn only with glyphs all share the same colors, so for those the change in the glyph's shade is what counts
+inline int cellError(const Cell& a, const Cell& b) {
+	int error = 0;
+	uint8_t colorA[3];
+	uint8_t colorB[3];
+	for (int background = 0; background < 2; background++) {
+		cellColorBGR(a, background, colorA);
+		cellColorBGR(b, background, colorB);
+		error += (abs(colorA[0] - colorB[0]) + 5 * abs(colorA[1] - colorB[1]) + 3 * abs(colorA[2] - colorB[2])) / 3;
+	}
+
+	if (memcmp(a.glyph, b.glyph, sizeof(a.glyph)) != 0) {
+		error += 192;
+	}
+	error += 4 * abs(a.shade - b.shade);
+
+	// Text from the overlay should never be left waiting behind the video
+	if (a.overlay || b.overlay) {
+		error += 4096;
+	}
+
+	// Cells that differ at all still need to be sent eventually
+	return max(error, 1);
+}
+
+// A pessimistic guess at how many bytes writing a cell takes, including moving the cursor to it
+inline int estimateCellBytes(const Cell& cell) {
+	int bytes = 8 + strlen(cell.glyph);
+	if (cell.colorType == CELL_COLOR_RGB)	bytes += 38;
+	else if (cell.colorType == CELL_COLOR_256)	bytes += 22;
+	else if (cell.colorType == CELL_COLOR_BASIC)	bytes += 10;
+	else	bytes += 4;
+	return bytes;
+}
+
+inline uint8_t nearestCubeLevel(uint8_t value) {
+	if (value < 48)	return 0;
+	if (value < 115)	return 1;
+	return (value - 35) / 40;
+}
+
+// Replaces a full color with the closest one from the 256 color palette, which takes far fewer bytes to send
+inline void coarsenColor(uint8_t* color) {
+	uint8_t b = nearestCubeLevel(color[0]);
+	uint8_t g = nearestCubeLevel(color[1]);
+	uint8_t r = nearestCubeLevel(color[2]);
+	color[0] = 16 + r * 36 + g * 6 + b;
+	color[1] = 0;
+	color[2] = 0;
+}
+
+inline void coarsenCell(Cell& cell) {
+	if (cell.colorType != CELL_COLOR_RGB)	return;
+	coarsenColor(cell.fg);
+	coarsenColor(cell.bg);
+	cell.colorType = CELL_COLOR_256;
+}
+
+// The version of a cell to send when the budget is tight: coarsened first, then the real thing once that's showing
+inline Cell budgetedCell(const Cell& frameCell, const Cell& shownCell) {
+	Cell cell = frameCell;
+	coarsenCell(cell);
+	if (cellsEqual(cell, shownCell)) {
+		return frameCell;
+	}
+	return cell;
+}
+
+// Like encodeCells, but sends at most roughly budget bytes worth of cells, picking the ones that look the most wrong first
+// Cells that don't fit are left out of shown, so they get picked up again by the next frame and the image converges
+// When not everything fits, full colors are sent as their closest 256 palette color, and refined later once there's room
+// At least one cell is always sent unless the budget is overdrawn, so a budget smaller than a cell still makes progress
+// region works the same as for encodeCells. Returns the number of changed cells left waiting
+int encodeCellsBudgeted(const CellGrid& frame, CellGrid& shown, long budget, vector<pair<int, int>>& changed, string& out,
+	const vector<CellSpan>* region = nullptr) {
+	// Find every changed cell, and how many bytes sending all of them would take
+	changed.clear();
+	long totalBytes = 0;
+	for (int i = 0; i < frame.rows; ++i) {
+		int left = region ? (*region)[i].left : 0;
+		int right = region ? (*region)[i].right : frame.cols;
+
+		for (int index = i * frame.cols + left; index < i * frame.cols + right; index++) {
+			if (cellsEqual(frame.cells[index], shown.cells[index]))	continue;
+
+			changed.push_back(make_pair(cellError(frame.cells[index], shown.cells[index]), index));
+			totalBytes += estimateCellBytes(frame.cells[index]);
+		}
+	}
+
+	bool coarsen = totalBytes > budget;
+	int selected = changed.size();
+
+	// Pick the worst looking cells until the budget runs out
+	if (coarsen) {
+		sort(changed.begin(), changed.end(), [](const pair<int, int>& a, const pair<int, int>& b) {
+			return a.first > b.first;
+		});
+
+		long bytes = 0;
+		selected = 0;
+		while (selected < (int) changed.size()) {
+			int index = changed[selected].second;
+			Cell cell = budgetedCell(frame.cells[index], shown.cells[index]);
+			bytes += estimateCellBytes(cell);
+			if (bytes > budget && (selected > 0 || budget < 0))	break;
+			selected++;
+		}
+
+		// Send the picked cells top to bottom, so moving the cursor between them stays cheap
+		sort(changed.begin(), changed.begin() + selected, [](const pair<int, int>& a, const pair<int, int>& b) {
+			return a.second < b.second;
+		});
+	}
+
+	// Nothing at all is written when no cell was picked, so waiting frames don't eat into the budget
+	if (selected == 0)	return changed.size();
+
+	out += "\033[?25l";
+
+	CellEncoder encoder(out, frame.cols);
+	for (int k = 0; k < selected; k++) {
+		int index = changed[k].second;
+		Cell cell = coarsen ? budgetedCell(frame.cells[index], shown.cells[index]) : frame.cells[index];
+
+		encoder.writeCell(index / frame.cols, index % frame.cols, cell);
+		shown.cells[index] = cell;
+	}
+
+	out += "\033[0m";
+
+	return changed.size() - selected;
+}
@@ -0,0 +1,120 @@
+#include <opencv2/opencv.hpp>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <stdio.h>
+
+#include "shell.cpp"
+#include "y4m.cpp"
+
+using namespace std;
+using namespace cv;
+
+// Jumping further ahead than this starts ffmpeg again at the new position, instead of decoding every frame in between
+const long DECODER_RESTART_MS = 2000;
+
+// Decodes a video file with ffmpeg into a y4m stream, for the color modes: opencv's ffmpeg backend only ever hands
+// over BGR or just the Y plane, while this gives the planar YUV 4:2:0 frames the renderers can read directly.
+// Frames are read in order as playback moves forward. Going back, or far ahead, starts ffmpeg again from there.
+class FileDecoder {
+	public:
+		int width;
+		int height;
+
+		FileDecoder() {
+			this->pipe = nullptr;
+			this->width = 0;
+			this->height = 0;
+			this->startMs = 0;
+			this->frameMs = 0;
+			this->framesRead = 0;
+		};
+
+		~FileDecoder() {
+			close();
+		};
+
+		// Starts decoding from the beginning, which also checks that ffmpeg can decode the file at all
+		bool open(const string& path, string& error) {
+			this->path = path;
+			return restart(0, error);
+		};
+
+		// Gets the frame that should be showing at positionMs, as planar YUV. Returns false once the video is over
+		// The frame points into the decoder's memory, so it's only valid until the next call
+		bool frameAt(long positionMs, Mat& frame) {
+			string error;
+			bool backwards = framesRead > 0 && positionMs < timeOf(framesRead - 1);
+			bool farAhead = positionMs - timeOf(framesRead) > DECODER_RESTART_MS;
+			if ((!pipe || backwards || farAhead) && !restart(positionMs, error))	return false;
+
+			// Skip ahead to the newest frame that's due; ffmpeg still decodes the ones in between, but nothing else is done with them
+			while (framesRead == 0 || timeOf(framesRead) <= positionMs) {
+				string line;
+				if (!readLine(fileno(pipe), line) || line.compare(0, 5, "FRAME") != 0)	return false;
+				if (!readExact(fileno(pipe), buffer.data(), buffer.size()))	return false;
+				framesRead++;
+			}
+
+			frame = Mat(height * 3 / 2, width, CV_8UC1, buffer.data());
+			return true;
+		};
+
+	private:
+		string path;
+		FILE* pipe;
+		vector<uint8_t> buffer;
+		long startMs; // Where ffmpeg was started from; its first frame is at this time
+		double frameMs;
+		long framesRead;
+
+		// y4m is always a constant frame rate, so every frame's time follows from where decoding started
+		long timeOf(long index) {
+			return startMs + (long) (index * frameMs);
+		};
+
+		void close() {
+			if (pipe)	pclose(pipe);
+			pipe = nullptr;
+		};
+
+		bool restart(long positionMs, string& error) {
+			close();
+
+			std::ostringstream command;
+			command << "ffmpeg -nostdin -v quiet -ss " << (positionMs / 1000.0) << " -i " << shellQuote(path);
+			command << " -an -f yuv4mpegpipe -pix_fmt yuv420p - 2>/dev/null";
+
+			pipe = popen(command.str().c_str(), "r");
+			if (!pipe) {
+				error = "Could not start ffmpeg";
+				return false;
+			}
+
+			string line;
+			if (!readLine(fileno(pipe), line) || line.compare(0, 9, "YUV4MPEG2") != 0) {
+				error = "ffmpeg could not decode the video";
+				close();
+				return false;
+			}
+
+			Y4MHeader header;
+			if (!parseY4MHeader(line, header, error)) {
+				close();
+				return false;
+			}
+			if (header.fpsNumerator <= 0) {
+				error = "ffmpeg gave no frame rate";
+				close();
+				return false;
+			}
+
+			width = header.width;
+			height = header.height;
+			frameMs = 1000.0 * header.fpsDenominator / header.fpsNumerator;
+			buffer.resize(width * height * 3 / 2);
+			startMs = positionMs;
+			framesRead = 0;
+			return true;
+		};
+};
@@ -0,0 +1,133 @@
+#pragma once
+
+#include <opencv2/opencv.hpp>
+
+using namespace cv;
+
+// The pixel formats a decoded frame can come in
+const int FRAME_BGR = 0; // Interleaved BGR, what opencv normally gives
+const int FRAME_Y = 1; // Only the luma plane, already in full range, for the grayscale color modes
+const int FRAME_I420 = 2; // Planar YUV 4:2:0: the Y plane followed by quarter size U and V planes
+
+inline uint8_t clampByte(int value) {
+	return value < 0 ? 0 : (value > 255 ? 255 : value);
+}
+
+// Y4M and other raw I420 sources give luma in limited range (16-235); this stretches it to 0-255 so it matches luma
+// worked out from BGR. The Y plane opencv hands over is already full range, since it comes from swscale's GRAY8
+struct FullRangeLuma {
+	uint8_t values[256];
+
+	FullRangeLuma() {
+		for (int k = 0; k < 256; k++) {
+			values[k] = clampByte(((k - 16) * 255 + 109) / 219);
+		}
+	};
+};
+
+const FullRangeLuma FULL_RANGE_LUMA;
+
+// A read-only view of (part of) a decoded frame, in whatever pixel format the decoder gave
+// Renderers read pixels through bgrAt and lumaAt, so only the cells that are actually sampled ever get converted,
+// instead of converting the whole frame to BGR first
+class FrameView {
+	public:
+		int format;
+		int width; // Size of the visible part of the frame
+		int height;
+
+		FrameView() {
+			this->format = FRAME_BGR;
+			this->width = 0;
+			this->height = 0;
+			this->x0 = 0;
+			this->y0 = 0;
+			this->fullHeight = 0;
+		};
+
+		// Works out the format of a decoded image; frameHeight is the height of the video itself,
+		// which tells a planar YUV image (half again as tall) apart from a luma-only one
+		FrameView(const Mat& image, int frameHeight) {
+			this->image = image;
+			this->x0 = 0;
+			this->y0 = 0;
+			this->width = image.cols;
+
+			if (image.channels() == 3) {
+				this->format = FRAME_BGR;
+				this->height = image.rows;
+			} else if (frameHeight > 0 && image.rows == frameHeight * 3 / 2) {
+				this->format = FRAME_I420;
+				this->height = frameHeight;
+			} else {
+				this->format = FRAME_Y;
+				this->height = image.rows;
+			}
+			this->fullHeight = this->height;
+		};
+
+		bool empty() const {
+			return image.empty();
+		};
+
+		// A view of just the area inside rect
+		FrameView crop(const cv::Rect& rect) const {
+			FrameView view = *this;
+			view.x0 = x0 + rect.x;
+			view.y0 = y0 + rect.y;
+			view.width = rect.width;
+			view.height = rect.height;
+			return view;
+		};
+
+		inline Vec3b bgrAt(int y, int x) const {
+			y += y0;
+			x += x0;
+
+			if (format == FRAME_BGR) {
+				return image.at<Vec3b>(y, x);
+			}
+
+			int luma = image.at<uint8_t>(y, x);
+			if (format == FRAME_Y) {
+				return Vec3b(luma, luma, luma);
+			}
+
+			// The U and V planes are stored one after another below the Y plane, each a quarter of its size
+			int chromaWidth = image.cols / 2;
+			int chromaIndex = (y / 2) * chromaWidth + (x / 2);
+			const uint8_t* planes = image.ptr(fullHeight);
+			int u = planes[chromaIndex] - 128;
+			int v = planes[chromaIndex + chromaWidth * (fullHeight / 2)] - 128;
+
+			// BT.601 limited range, the same conversion opencv uses for I420
+			int c = 298 * (luma - 16);
+			return Vec3b(
+				clampByte((c + 516 * u + 128) >> 8),
+				clampByte((c - 100 * u - 208 * v + 128) >> 8),
+				clampByte((c + 409 * v + 128) >> 8)
+			);
+		};
+
+		inline float lumaAt(int y, int x) const {
+			if (format == FRAME_BGR) {
+				// By mixing the colors like this, it closer mimics the grayscale color human eyes see, created a better looking grayscale
+				Vec3b pixel = image.at<Vec3b>(y + y0, x + x0);
+				return (0.2125 * pixel[0]) + (0.7154 * pixel[1]) + (0.0721 * pixel[2]);
+			}
+			uint8_t luma = image.at<uint8_t>(y + y0, x + x0);
+			return format == FRAME_I420 ? FULL_RANGE_LUMA.values[luma] : luma;
+		};
+
+	private:
+		Mat image;
+		int x0; // Where the visible part starts
+		int y0;
+		int fullHeight; // Height of the whole frame, which is where the chroma planes start
+};
+
+const char* framePathName(int format) {
+	if (format == FRAME_Y)	return "y-plane";
+	if (format == FRAME_I420)	return "yuv420";
+	return "bgr";
+}
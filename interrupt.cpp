@@ -0,0 +1,21 @@
+#pragma once
+
+#include <signal.h>
+#include <pthread.h>
+
+// Set by Ctrl+C; the main loop sees it and exits from there, since stopping the writer isn't safe inside a signal handler
+// Anything that blocks on the main thread should give up when a read or wait is interrupted and this is set
+volatile sig_atomic_t exitRequested = 0;
+
+void onInterrupt(int) {
+	exitRequested = 1;
+}
+
+// Leaves Ctrl+C to the main thread, so it never interrupts one of the helper threads instead
+// Call it first thing in every thread that gets started
+void blockInterruptInThisThread() {
+	sigset_t signals;
+	sigemptyset(&signals);
+	sigaddset(&signals, SIGINT);
+	pthread_sigmask(SIG_BLOCK, &signals, NULL);
+}
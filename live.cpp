@@ -0,0 +1,160 @@
+#include <opencv2/opencv.hpp>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <string>
+#include <vector>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "interrupt.cpp"
+#include "y4m.cpp"
+
+using namespace std;
+using namespace cv;
+
+// Reads raw frames from a pipe as they arrive, for live feeds that can't be opened or seeked like a file
+// Two formats are supported: a y4m stream (YUV 4:2:0), which is detected from its header, or headerless bgr24
+// frames of a size given up front. Neither is converted here; the renderers read them as they are.
+// Only the newest complete frame is kept; any frame that wasn't taken before the next one finished arriving is
+// dropped, so the picture never falls behind the feed.
+class LiveInput {
+	public:
+		int width;
+		int height;
+		int fps;
+		bool yuv; // Frames are planar YUV 4:2:0 rather than bgr24
+
+		atomic<bool> finished;
+		atomic<long> framesRead;
+		atomic<long> framesDropped;
+
+		LiveInput() {
+			this->fd = -1;
+			this->width = 0;
+			this->height = 0;
+			this->fps = 30;
+			this->yuv = false;
+			this->finished = false;
+			this->framesRead = 0;
+			this->framesDropped = 0;
+			this->readingIndex = 0;
+			this->latestIndex = 1;
+			this->takenIndex = 2;
+			this->hasLatest = false;
+		};
+
+		// Opens path ("-" for stdin) and reads the stream header if there is one
+		// rawWidth and rawHeight are only needed for bgr24 streams
+		bool open(const string& path, int rawWidth, int rawHeight, string& error) {
+			fd = path == "-" ? STDIN_FILENO : ::open(path.c_str(), O_RDONLY);
+			if (fd < 0) {
+				error = "Could not open " + path;
+				return false;
+			}
+
+			// y4m streams start with a signature; anything else is treated as bgr24
+			if (rawWidth <= 0 || rawHeight <= 0) {
+				string header;
+				if (!readLine(fd, header) || header.compare(0, 9, "YUV4MPEG2") != 0) {
+					error = "Live input is not a y4m stream; use --raw-size [width]x[height] for bgr24 frames";
+					return false;
+				}
+				Y4MHeader parsed;
+				if (!parseY4MHeader(header, parsed, error)) {
+					return false;
+				}
+				width = parsed.width;
+				height = parsed.height;
+				if (parsed.fpsNumerator > 0) {
+					fps = max(1, parsed.fpsNumerator / parsed.fpsDenominator);
+				}
+				yuv = true;
+			} else {
+				width = rawWidth;
+				height = rawHeight;
+				yuv = false;
+			}
+
+			frameSize = yuv ? width * height * 3 / 2 : width * height * 3;
+			for (int k = 0; k < 3; k++) {
+				buffers[k].resize(frameSize);
+			}
+			return true;
+		};
+
+		void start() {
+			thread = std::thread(&LiveInput::run, this);
+			thread.detach();
+		};
+
+		// Waits up to timeoutMs for a frame newer than the last one taken and puts it in frame
+		// arrival is set to when the frame finished arriving. Returns false if no new frame came
+		// y4m frames are handed over as planar YUV, as they arrived, and bgr24 frames as BGR
+		// The frame points into the reader's memory, so it's only valid until the next call
+		bool takeFrame(Mat& frame, chrono::steady_clock::time_point& arrival, int timeoutMs) {
+			{
+				unique_lock<mutex> lock(guard);
+				if (!wake.wait_for(lock, chrono::milliseconds(timeoutMs), [this] { return hasLatest || finished; })) {
+					return false;
+				}
+				if (!hasLatest)	return false;
+
+				swap(latestIndex, takenIndex);
+				hasLatest = false;
+				arrival = arrivals[takenIndex];
+			}
+
+			uint8_t* data = buffers[takenIndex].data();
+			if (yuv) {
+				frame = Mat(height * 3 / 2, width, CV_8UC1, data);
+			} else {
+				frame = Mat(height, width, CV_8UC3, data);
+			}
+			return true;
+		};
+
+	private:
+		int fd;
+		size_t frameSize;
+
+		// One buffer being read into, one holding the newest complete frame, and one that was last taken
+		vector<uint8_t> buffers[3];
+		chrono::steady_clock::time_point arrivals[3];
+		int readingIndex;
+		int latestIndex;
+		int takenIndex;
+		bool hasLatest;
+
+		mutex guard;
+		condition_variable wake;
+		std::thread thread;
+
+		void run() {
+			blockInterruptInThisThread();
+
+			string line;
+			while (true) {
+				// Every y4m frame starts with its own small header line
+				if (yuv && (!readLine(fd, line) || line.compare(0, 5, "FRAME") != 0))	break;
+				if (!readExact(fd, buffers[readingIndex].data(), frameSize))	break;
+
+				{
+					lock_guard<mutex> lock(guard);
+					arrivals[readingIndex] = chrono::steady_clock::now();
+					if (hasLatest) {
+						framesDropped++;
+					}
+					swap(readingIndex, latestIndex);
+					hasLatest = true;
+				}
+				framesRead++;
+				wake.notify_one();
+			}
+
+			finished = true;
+			wake.notify_all();
+		};
+};
@@ -0,0 +1,3 @@
+# Plays a synthetic live feed generated by ffmpeg, to try out live mode without a capture device.
+# Extra arguments are passed on to TerminalVideo, e.g. ./live_test.sh -c c -d
+ffmpeg -v error -re -f lavfi -i testsrc2=size=640x360:rate=30 -f yuv4mpegpipe -pix_fmt yuv420p - | ./TerminalVideo - --live $*
@@ -5,7 +5,14 @@
 #include <sys/ioctl.h>
 #include <signal.h>
 
-#include "notif.cpp"
+#include "interrupt.cpp"
+#include "overlay.cpp"
+#include "writer.cpp"
+#include "frame.cpp"
+#include "viewport.cpp"
+#include "live.cpp"
+#include "scrub.cpp"
+#include "decoder.cpp"
 
 using namespace cv;
 
@@ -16,9 +23,11 @@ const int MODE_MONOCHROME = 1;
 const int MODE_256 = 2;
 const int MODE_ASCII_ART = 3;
 const int MODE_ASCII_FULL = 4;
-const int MODE_DYNAMIC_RESOLUTION = 4;
+const int MODE_DYNAMIC_RESOLUTION = 5;
 int COLOR_MODE = MODE_DYNAMIC_RESOLUTION;
 
+bool useUnicode = true;
+
 const char ASCII_ART_GRADIENT[] = " .,-=+*/OQ&%@#NM";
 const char ASCII_FULL_GRADIENT[] = " `.-'\",:~_;!|^><+r*?=\\L/v()ic7x1z{tJ}lsT[]FnuCYjofy2ae3I5VSkwZ4mXPGhEqpAK6$bd9HODRgMUW%8N0&B#Q@";
 
@@ -26,8 +35,12 @@ const string BLOCK_HEIGHT_GRADIENT[] = {"▇", "▆", "▅", "▄", "▃", "▂"
 const string BLOCK_WIDTH_GRADIENT[] = {"▉", "▊", "▋", "▌", "▍", "▎", "▏"};
 
 sf::Music audioBuffer;
+TerminalWriter* terminalWriter = nullptr;
 
 void onExit(int s) {
+	// Let the writer finish its current frame so the reset below isn't mixed into it
+	if (terminalWriter)	terminalWriter->stop();
+
 	// Reset terminal colors and formatting
 	cout << "\033[0m\033[H\033[J\033[?25h" << endl;
 
@@ -38,7 +51,7 @@ void onExit(int s) {
 	// Stop the audio
 	audioBuffer.stop();
 
-	// Clear the onExit signal to prevent possible recursion
+	// Clear the onInterrupt signal so a second Ctrl+C during cleanup exits right away
 	struct sigaction sigIntHandler;
 
 	sigIntHandler.sa_handler = NULL;
@@ -76,19 +89,512 @@ inline Vec3b averagePixelsi(Vec3b vec1, Vec3b vec2, Vec3b vec3) {
 	return Vec3b((int) (vec1[0] + vec2[0] + vec3[0]) / 3, (int) (vec1[1] + vec2[1] + vec3[1]) / 3, (int) (vec1[2] + vec2[2] + vec3[2]) / 3);
 }
 
+// Makes a cell show nothing but black in the current color mode
+inline void setCellBlack(Cell& cell) {
+	static const uint8_t black[3] = {0, 0, 0};
+
+	setCellGlyph(cell, ' ');
+	if (COLOR_MODE == MODE_MONOCHROME) {
+		setCellBasic(cell, 7, 0);
+	} else if (COLOR_MODE == MODE_256) {
+		setCell256(cell, 16, 16);
+	} else if (COLOR_MODE == MODE_ASCII_ART || COLOR_MODE == MODE_ASCII_FULL) {
+		setCellDefault(cell);
+	} else {
+		setCellRGB(cell, black, black);
+	}
+}
+
+// Paints every cell outside the viewport black; rasterizing never touches these cells again
+void paintBars(CellGrid& grid, cv::Rect viewport) {
+	for (int i = 0; i < grid.rows; ++i) {
+		for (int j = 0; j < grid.cols; ++j) {
+			if (!viewport.contains(cv::Point(j, i))) {
+				setCellBlack(grid.at(i, j));
+			}
+		}
+	}
+}
+
+// Works out which cells can change from one frame to the next: the viewport, and the rows the overlay draws in
+// Everything else is a black bar, which only has to be sent with a full frame
+void changingRegion(vector<CellSpan>& region, cv::Rect viewport, int rows, int cols) {
+	region.resize(rows);
+	for (int i = 0; i < rows; ++i) {
+		if (i < OVERLAY_TOP_ROWS || i >= rows - OVERLAY_BOTTOM_ROWS) {
+			region[i] = {0, cols};
+		} else if (i >= viewport.y && i < viewport.y + viewport.height) {
+			region[i] = {viewport.x, viewport.x + viewport.width};
+		} else {
+			region[i] = {0, 0};
+		}
+	}
+}
+
+const char* colorModeName(int mode) {
+	if (mode == MODE_COLOR)	return "color";
+	if (mode == MODE_MONOCHROME)	return "monochrome";
+	if (mode == MODE_256)	return "256";
+	if (mode == MODE_ASCII_ART)	return "ascii-art";
+	if (mode == MODE_ASCII_FULL)	return "full-ascii";
+	return "dynamic";
+}
+
+// Rasterizes a frame into the cells of grid covered by area, stretching it to fit
+// If screenBuffer is given, cells whose sampled pixel looks the same as last time are left as they were
+// The grayscale modes only ever read luma, so they never pay for converting a YUV frame to color
+void rasterizeFrame(const FrameView& frame, CellGrid& grid, cv::Rect area, uint8_t* screenBuffer, bool screenBufferInited) {
+	// The video needs to be scaled to fit the area
+	float xScale = (float) frame.width / area.width;
+	float yScale = (float) frame.height / area.height;
+
+	// For every character in the area
+	for (int i = 0; i < area.height; ++i) {
+		for (int j = 0; j < area.width; ++j) {
+			// Logic to prevent redrawing pixels that look the same between frames
+			// This is mostly useful for videos with borders of some sort (i.e. movies or music videos)
+			Vec3b pixelBottom = frame.bgrAt(
+				(int) (i * yScale) + ((int) yScale/2),
+				(int) (j * xScale)
+			);
+
+			if (screenBuffer) {
+				int index = coordsToScreenBufferIndex(i, j, area.width);
+				if (screenBufferInited && COLOR_MODE != MODE_DYNAMIC_RESOLUTION) {
+					if (abs(screenBuffer[index + 0] - pixelBottom[0]) + abs(screenBuffer[index + 1] - pixelBottom[1]) + abs(screenBuffer[index + 2] - pixelBottom[2]) < 2) {
+						continue;
+					}
+				}
+				screenBuffer[index + 0] = pixelBottom[0];
+				screenBuffer[index + 1] = pixelBottom[1];
+				screenBuffer[index + 2] = pixelBottom[2];
+			}
+
+			Cell& cell = grid.at(area.y + i, area.x + j);
+
+			if (COLOR_MODE == MODE_DYNAMIC_RESOLUTION) {
+				// Obtain a second pixel
+				Vec3b pixelTop = frame.bgrAt(
+					(int) (i * yScale),
+					(int) (j * xScale)
+				);
+
+				Vec3b pixelTopR = frame.bgrAt(
+					(int) (i * yScale),
+					(int) (j * xScale) + ((int) xScale/2)
+				);
+
+				Vec3b pixelBottomR = frame.bgrAt(
+					(int) (i * yScale) + ((int) yScale/2),
+					(int) (j * xScale) + ((int) xScale/2)
+				);
+
+				// If color reduction is enabled, process that
+				if (COLOR_REDUCE > 0) {
+					float dither = (float) ((i + j) % 2) / 2.1;
+					pixelTop[0] = roundf(pixelTop[0] / COLOR_REDUCE + dither) * COLOR_REDUCE;
+					pixelTop[1] = roundf(pixelTop[1] / COLOR_REDUCE + dither) * COLOR_REDUCE;
+					pixelTop[2] = roundf(pixelTop[2] / COLOR_REDUCE + dither) * COLOR_REDUCE;
+					pixelBottom[0] = roundf(pixelBottom[0] / COLOR_REDUCE - dither) * COLOR_REDUCE;
+					pixelBottom[1] = roundf(pixelBottom[1] / COLOR_REDUCE - dither) * COLOR_REDUCE;
+					pixelBottom[2] = roundf(pixelBottom[2] / COLOR_REDUCE - dither) * COLOR_REDUCE;
+					pixelTopR[0] = roundf(pixelTopR[0] / COLOR_REDUCE + dither) * COLOR_REDUCE;
+					pixelTopR[1] = roundf(pixelTopR[1] / COLOR_REDUCE + dither) * COLOR_REDUCE;
+					pixelTopR[2] = roundf(pixelTopR[2] / COLOR_REDUCE + dither) * COLOR_REDUCE;
+					pixelBottomR[0] = roundf(pixelBottomR[0] / COLOR_REDUCE - dither) * COLOR_REDUCE;
+					pixelBottomR[1] = roundf(pixelBottomR[1] / COLOR_REDUCE - dither) * COLOR_REDUCE;
+					pixelBottomR[2] = roundf(pixelBottomR[2] / COLOR_REDUCE - dither) * COLOR_REDUCE;
+				}
+
+				float verticalSplit = similarityBetweenPixelsf(averagePixels(pixelTop, pixelTopR), averagePixels(pixelBottom, pixelBottomR));
+				float horizontalSplit = similarityBetweenPixelsf(averagePixels(pixelTop, pixelBottom), averagePixels(pixelTopR, pixelBottomR));
+				float diagonalSplit = similarityBetweenPixelsf(averagePixels(pixelTop, pixelBottomR), averagePixels(pixelTopR, pixelBottom));
+				float topLeft = similarityBetweenPixelsf(pixelTop, averagePixels(pixelTopR, pixelBottom, pixelBottomR)) * 0.035;
+				float topRight = similarityBetweenPixelsf(pixelTopR, averagePixels(pixelTop, pixelBottom, pixelBottomR)) * 0.035;
+				float bottomLeft = similarityBetweenPixelsf(pixelBottom, averagePixels(pixelTopR, pixelTop, pixelBottomR)) * 0.035;
+				float bottomRight = similarityBetweenPixelsf(pixelBottomR, averagePixels(pixelTop, pixelTopR, pixelBottom)) * 0.035;
+
+				if (
+					verticalSplit > horizontalSplit && verticalSplit > diagonalSplit &&
+					verticalSplit > topRight && verticalSplit > topLeft &&
+					verticalSplit > bottomLeft && verticalSplit > bottomRight
+				) {
+					float differences[7];
+					for (int k = 1; k < 8; k++) {
+						Vec3b pixel = frame.bgrAt(
+							(int) (i * yScale) + ((int) (((float) k) * yScale/8)),
+							(int) (j * xScale)
+						);
+
+						differences[k - 1] = similarityBetweenPixelsf(pixel, pixelTop);
+					}
+
+					int highestIndex;
+					float highestValue = -1;
+					for (int k = 1; k < 7; k++) {
+						float delta = abs(differences[k - 1] - differences[k]);
+						
+						if (delta > highestValue) {
+							highestValue = delta;
+							highestIndex = k;
+						}
+					}
+
+					setCellRGB(cell, pixelBottom.val, pixelTop.val);
+					setCellGlyph(cell, BLOCK_HEIGHT_GRADIENT[highestIndex].c_str());
+				} else if (
+					horizontalSplit > diagonalSplit &&
+					horizontalSplit > topRight && horizontalSplit > topLeft &&
+					horizontalSplit > bottomLeft && horizontalSplit > bottomRight
+				) {
+					Vec3b left = averagePixelsi(pixelTop, pixelBottom);
+					Vec3b right = averagePixelsi(pixelTopR, pixelBottomR);
+
+					float differences[7];
+					for (int k = 1; k < 8; k++) {
+						Vec3b pixel = frame.bgrAt(
+							(int) (i * yScale),
+							(int) (j * xScale) + ((int) (((float) k) * yScale/16))
+						);
+
+						differences[k - 1] = similarityBetweenPixelsf(pixel, left);
+					}
+
+					int highestIndex;
+					float highestValue = -1;
+					for (int k = 1; k < 7; k++) {
+						float delta = abs(differences[k - 1] - differences[k]);
+						
+						if (delta > highestValue) {
+							highestValue = delta;
+							highestIndex = k;
+						}
+					}
+
+					setCellRGB(cell, left.val, right.val);
+					setCellGlyph(cell, BLOCK_WIDTH_GRADIENT[highestIndex].c_str());
+				} else if (
+					diagonalSplit > topRight && diagonalSplit > topLeft &&
+					diagonalSplit > bottomLeft && diagonalSplit > bottomRight
+				) {
+					Vec3b B = averagePixelsi(pixelTop, pixelBottomR);
+					Vec3b A = averagePixelsi(pixelTopR, pixelBottom);
+					setCellRGB(cell, A.val, B.val);
+					setCellGlyph(cell, "▞");
+				} else if (
+					topRight > topLeft && topRight > bottomLeft && topRight > bottomRight
+				) {
+					Vec3b A = averagePixelsi(pixelTop, pixelBottom, pixelBottomR);
+					setCellRGB(cell, pixelTopR.val, A.val);
+					setCellGlyph(cell, "▝");
+				} else if (
+					topLeft > bottomLeft && topLeft > bottomRight
+				) {
+					Vec3b A = averagePixelsi(pixelTopR, pixelBottom, pixelBottomR);
+					setCellRGB(cell, pixelTop.val, A.val);
+					setCellGlyph(cell, "▘");
+				} else if (
+					bottomLeft > bottomRight
+				) {
+					Vec3b A = averagePixelsi(pixelTopR, pixelTop, pixelBottomR);
+					setCellRGB(cell, pixelBottom.val, A.val);
+					setCellGlyph(cell, "▖");
+				} else {
+					Vec3b A = averagePixelsi(pixelTopR, pixelTop, pixelBottom);
+					setCellRGB(cell, pixelBottomR.val, A.val);
+					setCellGlyph(cell, "▗");
+				}
+
+			} else if (COLOR_MODE == MODE_COLOR) {
+				// Obtain a second pixel
+				Vec3b pixelTop = frame.bgrAt(
+					(int) (i * yScale),
+					(int) (j * xScale)
+				);
+
+				// If color reduction is enabled, process that
+				if (COLOR_REDUCE > 0) {
+					float dither = (float) ((i + j) % 2) / 2.1;
+					pixelTop[0] = roundf(pixelTop[0] / COLOR_REDUCE + dither) * COLOR_REDUCE;
+					pixelTop[1] = roundf(pixelTop[1] / COLOR_REDUCE + dither) * COLOR_REDUCE;
+					pixelTop[2] = roundf(pixelTop[2] / COLOR_REDUCE + dither) * COLOR_REDUCE;
+					pixelBottom[0] = roundf(pixelBottom[0] / COLOR_REDUCE - dither) * COLOR_REDUCE;
+					pixelBottom[1] = roundf(pixelBottom[1] / COLOR_REDUCE - dither) * COLOR_REDUCE;
+					pixelBottom[2] = roundf(pixelBottom[2] / COLOR_REDUCE - dither) * COLOR_REDUCE;
+				}
+
+				// Set the background color to the top pixel, and the foreground color to the bottom pixel and print a half-block character
+				// This gives the illusion of having double vertical resolution, since a block character is usually 1:1 and a character 1:2
+				if (similarityBetweenPixels(pixelTop, pixelBottom) == 0) { // If the top and bottom pixels are the same, don't change both the background and foreground color
+					setCellRGB(cell, pixelTop.val, pixelTop.val);
+					setCellGlyph(cell, ' ');
+				} else {
+					if (useUnicode) {
+						setCellRGB(cell, pixelBottom.val, pixelTop.val);
+						setCellGlyph(cell, "▄");
+					} else {
+						setCellRGB(cell, pixelBottom.val, pixelTop.val);
+						setCellGlyph(cell, '_');
+					}
+				}
+			} else if (COLOR_MODE == MODE_MONOCHROME) {
+				setCellBasic(cell, 7, 0);
+
+				float grayScale = frame.lumaAt(
+					(int) (i * yScale),
+					(int) (j * xScale)
+				);
+
+				float grayScaleUp = 255;
+				if (i != 0) {
+					grayScaleUp = frame.lumaAt(
+						(int) (i * yScale) - ((int) yScale/2),
+						(int) (j * xScale)
+					);
+				}
+
+				float grayScaleDown = 255;
+				if (i + 1 != area.height) {
+					grayScaleDown = frame.lumaAt(
+						(int) (i * yScale) + ((int) yScale/2),
+						(int) (j * xScale)
+					);
+				}
+
+				if (useUnicode) {
+					if (grayScale > 240 && grayScaleUp < 16) {
+						setCellGlyph(cell, "▄");
+						setCellShade(cell, 128);
+						continue;
+					} else if (grayScale > 240 && grayScaleDown < 16) {
+						setCellGlyph(cell, "▀");
+						setCellShade(cell, 128);
+						continue;
+					}
+				} else {
+					if (grayScale > 240 && grayScaleUp < 16) {
+						setCellGlyph(cell, ",");
+						setCellShade(cell, 128);
+						continue;
+					} else if (grayScale > 240 && grayScaleDown < 16) {
+						setCellGlyph(cell, "'");
+						setCellShade(cell, 128);
+						continue;
+					}
+				}
+
+				// Normalize the values 0-5 and dither
+				grayScale /= 25.6;
+				if (((int) round(grayScale)) % 2 == 1) {
+					if ((i + j) % 2 == 0 && grayScale - 0.4 > round(grayScale)) {
+						grayScale = round(grayScale - 1);
+					} else {
+						grayScale = round(grayScale + 1);
+					}
+				}
+
+				grayScale /= 2;
+
+				// Convert a value to a character of a certain brightness
+				const char* character;
+				int grayScaleInt = (int) grayScale;
+				if (grayScaleInt == 0) {
+					character = " ";
+				} else if (grayScaleInt == 1) {
+					character = ".";
+				} else if (grayScaleInt == 2) {
+					character = "░";
+				} else if (grayScaleInt == 3) {
+					character = "▒";
+				} else if (grayScaleInt == 4) {
+					character = "▓";
+				} else {
+					character = "█";
+				}
+
+				setCellGlyph(cell, character);
+				setCellShade(cell, min(grayScaleInt, 5) * 51);
+
+				// (0.2125 * color.r) + (0.7154 * color.g) + (0.0721 * color.b)
+			} else if (COLOR_MODE == MODE_256) {
+				// Obtain two pixels
+				Vec3b pixelTop = frame.bgrAt(
+					(int) (i * yScale),
+					(int) (j * xScale)
+				);
+
+				// Normalize colors 0-5
+				pixelTop[0] = (j % 2 == 1) ? round(pixelTop[0] / 51) : floor(pixelTop[0] / 51);
+				pixelTop[1] = (j % 2 == 1) ? round(pixelTop[1] / 51) : floor(pixelTop[1] / 51);
+				pixelTop[2] = (j % 2 == 1) ? round(pixelTop[2] / 51) : floor(pixelTop[2] / 51);
+				pixelBottom[0] = (j % 2 == 0) ? round(pixelBottom[0] / 51) : floor(pixelBottom[0] / 51);
+				pixelBottom[1] = (j % 2 == 0) ? round(pixelBottom[1] / 51) : floor(pixelBottom[1] / 51);
+				pixelBottom[2] = (j % 2 == 0) ? round(pixelBottom[2] / 51) : floor(pixelBottom[2] / 51);
+
+				int topColor;
+				int bottomColor;
+
+				// The 256 color palette has extra shades of gray. This code uses that.
+				if ((int) pixelTop[0] == (int) pixelTop[1] && (int) pixelTop[1] == (int) pixelTop[2]) {
+					topColor = round(pixelTop[0] * 4.6) + 232;
+				} else {
+					topColor = pixelTop[2] + (pixelTop[1] * 6) + (pixelTop[0] * 36) + 16;
+				}
+				if ((int) pixelBottom[0] == (int) pixelBottom[1] && (int) pixelBottom[1] == (int) pixelBottom[2]) {
+					bottomColor = round(pixelBottom[0] * 4.6) + 232;
+				} else {
+					bottomColor = pixelBottom[2] + (pixelBottom[1] * 6) + (pixelBottom[0] * 36) + 16;
+				}
+
+				// Set the background color to the top pixel, and the foreground color to the bottom pixel and print a half-block character
+				// This gives the illusion of having double vertical resolution, since a block character is usually 1:1 and a character 1:2
+				if (useUnicode) {
+					setCell256(cell, bottomColor, topColor);
+					setCellGlyph(cell, "▄");
+				} else {
+					setCell256(cell, bottomColor, topColor);
+					setCellGlyph(cell, '_');
+				}
+			} else if (COLOR_MODE == MODE_ASCII_ART) {
+				float grayScale = frame.lumaAt(
+					(int) (i * yScale),
+					(int) (j * xScale)
+				);
+
+				// Normalize the values 0-14 and dither
+				grayScale /= 8.534;
+				if (((int) round(grayScale)) % 2 == 1) {
+					if ((i + j) % 2 == 0 && grayScale - 0.4 > round(grayScale)) {
+						grayScale = round(grayScale - 1);
+					} else {
+						grayScale = round(grayScale + 1);
+					}
+				}
+
+				grayScale /= 2;
+
+				setCellDefault(cell);
+				setCellGlyph(cell, ASCII_ART_GRADIENT[(int) grayScale]);
+				setCellShade(cell, (int) grayScale * 255 / (sizeof(ASCII_ART_GRADIENT) - 2));
+
+				// (0.2125 * color.r) + (0.7154 * color.g) + (0.0721 * color.b)
+			} else if (COLOR_MODE == MODE_ASCII_FULL) {
+				float grayScale = frame.lumaAt(
+					(int) (i * yScale),
+					(int) (j * xScale)
+				);
+
+				// Normalize the values 0-94 and dither
+				grayScale /= 1.347368421;
+				if (((int) round(grayScale)) % 2 == 1) {
+					if ((i + j) % 2 == 0 && grayScale - 0.4 > round(grayScale)) {
+						grayScale = round(grayScale - 1);
+					} else {
+						grayScale = round(grayScale + 1);
+					}
+				}
+
+				grayScale /= 2;
+
+				// Dithering can push the brightest pixels one step past the end of the gradient
+				int gradientIndex = min((int) grayScale, (int) sizeof(ASCII_FULL_GRADIENT) - 2);
+
+				setCellDefault(cell);
+				setCellGlyph(cell, ASCII_FULL_GRADIENT[gradientIndex]);
+				setCellShade(cell, gradientIndex * 255 / (sizeof(ASCII_FULL_GRADIENT) - 2));
+
+				// (0.2125 * color.r) + (0.7154 * color.g) + (0.0721 * color.b)
+			}
+
+		}
+	}
+}
+
+// Works out the layout of the scrub preview: a 3x3 grid when there's room, otherwise a strip of 3
+// The top row holds the controls and the bottom row the progress bar; each thumbnail has a label under it
+void scrubLayout(int rows, int cols, int& gridRows, int& gridCols, int& tileWidth, int& tileHeight) {
+	gridCols = 3;
+	gridRows = (rows >= 24 && cols >= 60) ? 3 : 1;
+
+	tileWidth = max(1, (cols - (gridCols + 1)) / gridCols);
+	tileHeight = max(1, (rows - 2 - (gridRows + 1)) / gridRows - 1);
+}
+
+// Where a thumbnail goes inside a tile, keeping the shape of the video
+cv::Rect scrubPicture(int tileWidth, int tileHeight, int videoWidth, int videoHeight, float cellAspect) {
+	if (videoWidth <= 0 || videoHeight <= 0)	return cv::Rect(0, 0, tileWidth, tileHeight);
+	return fitViewport(videoWidth, videoHeight, tileWidth, tileHeight, cellAspect);
+}
+
+// Draws the scrub preview over the whole grid, rendering each thumbnail with the current color mode
+void drawScrubPreview(CellGrid& grid, Scrubber& scrubber, int videoWidth, int videoHeight, float cellAspect) {
+	int gridRows, gridCols, tileWidth, tileHeight;
+	scrubLayout(grid.rows, grid.cols, gridRows, gridCols, tileWidth, tileHeight);
+	cv::Rect picture = scrubPicture(tileWidth, tileHeight, videoWidth, videoHeight, cellAspect);
+
+	for (Cell& cell : grid.cells) {
+		setCellBlack(cell);
+	}
+
+	const char hint[] = " Left/Right/Up/Down: choose   Enter: jump there   Esc: go back ";
+	drawOverlayText(grid, 0, max(0, (grid.cols - (int) strlen(hint)) / 2), hint, strlen(hint));
+
+	for (int k = 0; k < gridRows * gridCols; k++) {
+		int index = scrubber.first + k;
+		if (!scrubber.exists(index))	break;
+
+		int top = 2 + (k / gridCols) * (tileHeight + 2);
+		int left = 1 + (k % gridCols) * (tileWidth + 1);
+
+		// On a tiny terminal the tiles can run off the grid, so only the part that's on it is drawn
+		cv::Rect tile = cv::Rect(left + picture.x, top + picture.y, picture.width, picture.height) & cv::Rect(0, 0, grid.cols, grid.rows);
+
+		Mat thumbnail;
+		bool decoded = scrubber.get(index, thumbnail);
+		if (!thumbnail.empty() && tile.area() > 0) {
+			rasterizeFrame(FrameView(thumbnail, thumbnail.rows), grid, tile, nullptr, false);
+		}
+
+		// Label each thumbnail with its time, and whether it's still on the way
+		char label[32];
+		int length = 0;
+		label[length++] = ' ';
+		length += formatTimestamp(label + length, scrubber.timeOf(index));
+		if (!decoded) {
+			length += sprintf(label + length, " ...");
+		} else if (thumbnail.empty()) {
+			length += sprintf(label + length, " (none)");
+		}
+		label[length++] = ' ';
+
+		int labelRow = top + tileHeight;
+		int labelLeft = left + max(0, (tileWidth - length) / 2);
+		drawOverlayText(grid, labelRow, labelLeft, label, min(length, tileWidth));
+
+		// The selected thumbnail gets an inverted label
+		if (index == scrubber.selected && labelRow < grid.rows) {
+			for (int c = labelLeft; c < labelLeft + min(length, tileWidth) && c < grid.cols; c++) {
+				setCellBasic(grid.at(labelRow, c), 0, 7);
+			}
+		}
+	}
+}
+
 int main(int argc, char *argv[]) {
-	// Setup the onExit signal to properly close the program
+	// Setup the onInterrupt signal to properly close the program
 	struct sigaction sigIntHandler;
 
-	sigIntHandler.sa_handler = onExit;
+	sigIntHandler.sa_handler = onInterrupt;
 	sigemptyset(&sigIntHandler.sa_mask);
 	sigIntHandler.sa_flags = 0;
 
 	sigaction(SIGINT, &sigIntHandler, NULL);
 
-	// Get the size of the terminal
+	// Get the size of the terminal, from stdout first since stdin may be a pipe in live mode
 	struct winsize terminalSize;
-	ioctl(0, TIOCGWINSZ, &terminalSize);
+	if (ioctl(STDOUT_FILENO, TIOCGWINSZ, &terminalSize) != 0) {
+		ioctl(STDIN_FILENO, TIOCGWINSZ, &terminalSize);
+	}
 
 	// Disable warning messages from opencv that mess up video
 	setenv("OPENCV_LOG_LEVEL", "OFF", 1);
@@ -96,6 +602,9 @@ int main(int argc, char *argv[]) {
 
 	long startOffset = 0;
 	float volume = 100;
+	long bandwidth = 0;
+	int rawWidth = 0;
+	int rawHeight = 0;
 
 	// Enforce arguments
 	if (argc < 2) {
@@ -108,20 +617,29 @@ int main(int argc, char *argv[]) {
 	
 	bool useKeyboard = true;
 	bool useAudio = true;
-	bool useUnicode = true;
+	bool detectLetterbox = true;
+	bool stretchVideo = false;
+	bool liveMode = false;
+	float cellAspect = detectCellAspect(terminalSize);
 
 	// Help message
 	if (!std::string("--help").compare(argv[1]) || !std::string("-h").compare(argv[1])) {
 		cout << "TerinalVideo2" << endl;
 		cout << "Usage: " << argv[0] << " <video_name> [arguments]" << endl << endl;
 		cout << "Arguments: " << endl;
+		cout << " --bandwidth [bytes]  -b [bytes]    Limit output to [bytes] per second, refining the picture over several frames" << endl;
+		cout << " --cell-aspect [n]    -ca [n]       Set how many times taller than wide a character is, if it's detected wrong" << endl;
 		cout << " --color-mode [mode]  -c [mode]     Set the color mode: m monochrome, c color, 256 256-compatability" << endl;
 		cout << " --debug              -d            Print extra status messages to help diagnose issues" << endl;
 		cout << " --help               -h            Display this help screen" << endl;
+		cout << " --live               -l            Show a live feed of raw frames from a pipe (or - for stdin) as they arrive" << endl;
 		cout << " --no-audio           -na           Removes audio, can help with compatibility" << endl;
+		cout << " --no-crop            -nc           Don't look for black bars in the video to crop away" << endl;
 		cout << " --no-keyboard        -nk           Removes keyboard control, can help with compatibility" << endl;
 		cout << " --no-unicode         -nu           Replaces unicode characters in certain color modes, can help with compatibility" << endl;
 		cout << " --offset [ms]        -o [ms]       Start [ms] milliseconds into the video" << endl;
+		cout << " --raw-size [w]x[h]   -r [w]x[h]    Live input is headerless bgr24 frames of this size, instead of a y4m stream" << endl;
+		cout << " --stretch            -s            Stretch the video to fill the terminal instead of keeping its shape" << endl;
 		cout << " --volume             -v [percent]  Set the volume in range 0% to 100%" << endl << endl;
 		cout << "Color Modes: " << endl;
 		cout << " color                 c            Uses full RGB" << endl;
@@ -133,6 +651,8 @@ int main(int argc, char *argv[]) {
 		cout << "Controls: " << endl;
 		cout << " Left and right arrow keys          Skip 5 seconds backward or forward respectively" << endl;
 		cout << " Up and down arrow keys             Raise and lower the volume by 10% respectively" << endl;
+		cout << " I                                  Toggle showing the progress bar, volume and color mode" << endl;
+		cout << " S                                  Open the scrub preview: pick a thumbnail with the arrow keys, Enter to jump there" << endl;
 		exit(0);
 	}
 
@@ -148,6 +668,14 @@ int main(int argc, char *argv[]) {
 			} else if (!std::string("-v").compare(argv[argIndex]) || !std::string("--volume").compare(argv[argIndex])) {
 				volume = stof(string(argv[argIndex + 1]));
 				
+				argIndex++; // Make sure to increment one extra to skip the number
+			} else if (!std::string("-b").compare(argv[argIndex]) || !std::string("--bandwidth").compare(argv[argIndex])) {
+				bandwidth = stol(string(argv[argIndex + 1]));
+
+				argIndex++; // Make sure to increment one extra to skip the number
+			} else if (!std::string("-ca").compare(argv[argIndex]) || !std::string("--cell-aspect").compare(argv[argIndex])) {
+				cellAspect = stof(string(argv[argIndex + 1]));
+
 				argIndex++; // Make sure to increment one extra to skip the number
 			} else if (!std::string("-c").compare(argv[argIndex]) || !std::string("--color-mode").compare(argv[argIndex])) {
 				if (argv[argIndex + 1][0] == ("c")[0]) {
@@ -167,10 +695,23 @@ int main(int argc, char *argv[]) {
 				argIndex++; // Make sure to increment one extra to skip the mode
 			} else if (!std::string("-d").compare(argv[argIndex]) || !std::string("--debug").compare(argv[argIndex])) {
 				debugMode = true;
+			} else if (!std::string("-l").compare(argv[argIndex]) || !std::string("--live").compare(argv[argIndex])) {
+				liveMode = true;
+			} else if (!std::string("-r").compare(argv[argIndex]) || !std::string("--raw-size").compare(argv[argIndex])) {
+				if (sscanf(argv[argIndex + 1], "%dx%d", &rawWidth, &rawHeight) != 2) {
+					cout << "Invalid raw frame size: " << argv[argIndex + 1] << endl;
+					exit(0);
+				}
+
+				argIndex++; // Make sure to increment one extra to skip the size
 			} else if (!std::string("-nk").compare(argv[argIndex]) || !std::string("--no-keyboard").compare(argv[argIndex])) {
 				useKeyboard = false;
 			} else if (!std::string("-na").compare(argv[argIndex]) || !std::string("--no-audio").compare(argv[argIndex])) {
 				useAudio = false;
+			} else if (!std::string("-nc").compare(argv[argIndex]) || !std::string("--no-crop").compare(argv[argIndex])) {
+				detectLetterbox = false;
+			} else if (!std::string("-s").compare(argv[argIndex]) || !std::string("--stretch").compare(argv[argIndex])) {
+				stretchVideo = true;
 			} else if (!std::string("-nu").compare(argv[argIndex]) || !std::string("--no-unicode").compare(argv[argIndex])) {
 				useUnicode = false;
 			} else {
@@ -184,15 +725,61 @@ int main(int argc, char *argv[]) {
 
 	// Attempt to load the video file into opencv
 	cv::VideoCapture capture;
-	cv::Mat RGB;
+	cv::Mat RGB; // Not necessarily BGR; see FrameView for the formats this can hold
 
 	string videoPath = argv[1];
 
-	if (!capture.open(videoPath)) {
+	// Reading from stdin only makes sense as a live feed
+	if (videoPath == "-") {
+		liveMode = true;
+	}
+
+	// Live feeds can't be seeked and have no audio track to extract
+	LiveInput liveInput;
+	if (liveMode) {
+		string error;
+		if (!liveInput.open(videoPath, rawWidth, rawHeight, error)) {
+			// Ctrl+C while waiting for the stream to start isn't an error worth reporting
+			if (!exitRequested)
+				cout << error << endl;
+			return 1;
+		}
+		useAudio = false;
+		liveInput.start();
+	} else if (!capture.open(videoPath)) {
 		cout << "Video not found, is unreadable, or in wrong format!"<<endl;
 		return 1;
 	}
 
+	// The grayscale modes only need luma, so ask the decoder for just that instead of a full BGR frame
+	// Decoders that can't do this keep giving BGR, which still works, just slower
+	bool grayscaleMode = COLOR_MODE == MODE_MONOCHROME || COLOR_MODE == MODE_ASCII_ART || COLOR_MODE == MODE_ASCII_FULL;
+	if (!liveMode && grayscaleMode) {
+		if (debugMode)
+			cout << "Requesting luma-only frames from the decoder..." << endl;
+
+		capture.set(cv::CAP_PROP_CONVERT_RGB, false);
+	}
+
+	// The color modes need U and V as well, which opencv's ffmpeg backend never hands over, so files are decoded by
+	// ffmpeg itself into planar YUV. If that doesn't work, opencv's BGR frames are used instead
+	// opencv still opens the file either way, for its frame rate, length and size
+	FileDecoder fileDecoder;
+	bool useFileDecoder = false;
+	if (!liveMode && !grayscaleMode) {
+		if (debugMode)
+			cout << "Starting ffmpeg for planar YUV frames..." << endl;
+
+		string error;
+		useFileDecoder = fileDecoder.open(videoPath, error);
+		if (!useFileDecoder && debugMode)
+			cout << error << ", decoding to BGR instead" << endl;
+	}
+
+	// Needed to tell planar YUV frames apart from luma-only ones, and to keep the shape of the scrub thumbnails
+	int frameWidth = liveMode ? liveInput.width : (useFileDecoder ? fileDecoder.width : (int) capture.get(cv::CAP_PROP_FRAME_WIDTH));
+	int frameHeight = liveMode ? liveInput.height : (useFileDecoder ? fileDecoder.height : (int) capture.get(cv::CAP_PROP_FRAME_HEIGHT));
+
 
 	if (useAudio) {
 		// Use ffmpeg to extract the audio from the video
@@ -221,7 +808,7 @@ int main(int argc, char *argv[]) {
 	if (debugMode)
 		cout << "Calculating time-related variables..." << endl;
 
-	const int FPS = capture.get(cv::CAP_PROP_FPS);
+	const int FPS = liveMode ? liveInput.fps : capture.get(cv::CAP_PROP_FPS);
 
 	// Get the current time (minus start offset)
 	auto time = std::chrono::system_clock::now();
@@ -238,20 +825,124 @@ int main(int argc, char *argv[]) {
 	bool wasRight = false;
 	bool wasUp = false;
 	bool wasDown = false;
+	bool wasInfo = false;
+	bool wasScrub = false;
+	bool wasEnter = false;
+
+	// The scrub preview shows thumbnails around the current position to jump to
+	Scrubber scrubber;
+	bool scrubbing = false;
+	long scrubStartPosition = 0;
 
 	// The screen buffer holds the previous frame and is checked against to prevent updating pixels that look the same between frames
-	uint8_t screenBuffer[terminalSize.ws_row * terminalSize.ws_col * 3];
+	vector<uint8_t> screenBuffer;
 	bool screenBufferInited = false;
 
+	// The video is rasterized into videoGrid, which is copied into the writer's back buffer to have the overlay drawn over it
+	CellGrid videoGrid(terminalSize.ws_row, terminalSize.ws_col);
+
+	// The video is only drawn inside the viewport; the cells around it are painted black once and then left alone
+	// crop is the part of the video frame that's shown, which leaves out any black bars baked into the video
+	LetterboxDetector letterbox;
+	cv::Rect crop;
+	cv::Rect viewport;
+
+	// Only the viewport and the overlay's rows are copied and diffed each frame; the scrub preview draws everywhere
+	vector<CellSpan> region;
+	vector<CellSpan> wholeScreen(terminalSize.ws_row, CellSpan{0, terminalSize.ws_col});
+
+	// The writer thread keeps track of what the terminal is showing, so only changed cells get sent
+	cout.flush();
+	terminalWriter = new TerminalWriter(terminalSize.ws_row, terminalSize.ws_col, STDOUT_FILENO);
+	terminalWriter->setByteBudget(bandwidth);
+	terminalWriter->start();
+
+	// Once a second, the writer's statistics are turned into rates for --debug
+	overlayStatsEnabled = debugMode;
+	long lastStatsMillis = originalMillis.count();
+	long lastBlockedMicros = 0;
+	long lastFramesWritten = 0;
+	long lastFramesDropped = 0;
+	long lastLiveDropped = 0;
+	long lastFrameMillis = originalMillis.count();
+	int framePath = FRAME_BGR;
+
+	// When the current frame arrived, for measuring how long it takes to reach the terminal
+	auto frameArrival = std::chrono::steady_clock::now();
+
+	if (!liveMode) {
+		overlayDurationMs = (long) (capture.get(cv::CAP_PROP_FRAME_COUNT) / capture.get(cv::CAP_PROP_FPS) * 1000);
+	}
+	overlayVolume = (int) volume;
+	overlayModeName = colorModeName(COLOR_MODE);
+	showOverlayWidget(modeWidget);
+
+	// Ctrl+C during setup only set the flag, so honor it before anything gets drawn
+	if (exitRequested) {
+		onExit(0);
+	}
+
 	while (true) {
+		if (exitRequested) {
+			onExit(0);
+		}
+
 		// Get the current time
 		auto time = std::chrono::system_clock::now();
 		auto since_epoch = time.time_since_epoch();
 		auto millis = std::chrono::duration_cast<std::chrono::milliseconds>(since_epoch);
 
-		if (useKeyboard) {
-			// Skipping 5 seconds logic
+		if (useKeyboard && scrubbing) {
+			// While scrubbing, the arrow keys move the selection instead
 			if (sf::Keyboard::isKeyPressed(sf::Keyboard::Left) && !wasLeft) {
+				wasLeft = true;
+				scrubber.move(-1);
+			} else if (sf::Keyboard::isKeyPressed(sf::Keyboard::Right) && !wasRight) {
+				wasRight = true;
+				scrubber.move(1);
+			} else if (sf::Keyboard::isKeyPressed(sf::Keyboard::Up) && !wasUp) {
+				wasUp = true;
+				scrubber.move(-scrubber.gridCols);
+			} else if (sf::Keyboard::isKeyPressed(sf::Keyboard::Down) && !wasDown) {
+				wasDown = true;
+				scrubber.move(scrubber.gridCols);
+			}
+
+			if (!sf::Keyboard::isKeyPressed(sf::Keyboard::Left) && wasLeft)	wasLeft = false;
+			if (!sf::Keyboard::isKeyPressed(sf::Keyboard::Right) && wasRight)	wasRight = false;
+			if (!sf::Keyboard::isKeyPressed(sf::Keyboard::Up) && wasUp)	wasUp = false;
+			if (!sf::Keyboard::isKeyPressed(sf::Keyboard::Down) && wasDown)	wasDown = false;
+
+			// Confirming jumps to the selected thumbnail; cancelling goes back to where scrubbing started
+			bool confirm = sf::Keyboard::isKeyPressed(sf::Keyboard::Enter) && !wasEnter;
+			bool cancel = (sf::Keyboard::isKeyPressed(sf::Keyboard::Escape) || sf::Keyboard::isKeyPressed(sf::Keyboard::S)) && !wasScrub;
+			if (confirm || cancel) {
+				long target = confirm ? scrubber.timeOf(scrubber.selected) : scrubStartPosition;
+
+				start = millis.count() - target;
+				startOffset = originalMillis.count() - start;
+				if (useAudio) {
+					audioBuffer.setPlayingOffset(sf::milliseconds(target));
+					audioBuffer.play();
+				}
+
+				scrubbing = false;
+				terminalWriter->requestFullFrame(); // The preview covered the bars around the video
+				wasEnter = true;
+				wasScrub = true;
+				if (confirm) {
+					addNotification("Jumped to the selected thumbnail");
+				}
+				showOverlayWidget(progressWidget);
+			}
+
+			if (!sf::Keyboard::isKeyPressed(sf::Keyboard::Enter) && wasEnter)	wasEnter = false;
+			if (!sf::Keyboard::isKeyPressed(sf::Keyboard::Escape) && !sf::Keyboard::isKeyPressed(sf::Keyboard::S) && wasScrub)	wasScrub = false;
+		} else if (useKeyboard) {
+			// Skipping 5 seconds logic
+			if (liveMode) {
+				// Live feeds can't be skipped through
+			} else if (sf::Keyboard::isKeyPressed(sf::Keyboard::Left) && !wasLeft) {
 				wasLeft = true;
 				startOffset -= 5000;
 				if (millis.count() - (originalMillis.count() - startOffset) < 0) {
@@ -261,7 +952,8 @@ int main(int argc, char *argv[]) {
 				if (useAudio)
 					audioBuffer.setPlayingOffset(sf::milliseconds(startOffset + (millis.count() - originalMillis.count())));
 				
-				addNotification(new Notification("Skipped 5 seconds back"));
+				addNotification("Skipped 5 seconds back");
+				showOverlayWidget(progressWidget);
 			} else if (sf::Keyboard::isKeyPressed(sf::Keyboard::Right) && !wasRight) {
 				wasRight = true;
 				startOffset += 5000;
@@ -269,7 +961,8 @@ int main(int argc, char *argv[]) {
 				if (useAudio)
 					audioBuffer.setPlayingOffset(sf::milliseconds(startOffset + (millis.count() - originalMillis.count())));
 				
-				addNotification(new Notification("Skipped 5 seconds forward"));
+				addNotification("Skipped 5 seconds forward");
+				showOverlayWidget(progressWidget);
 			}
 
 			if (!sf::Keyboard::isKeyPressed(sf::Keyboard::Left) && wasLeft)	wasLeft = false;
@@ -282,455 +975,166 @@ int main(int argc, char *argv[]) {
 				if (volume > 100) volume = 100;
 				audioBuffer.setVolume(volume);
 				
-				addNotification(new Notification("Volume raised to " + to_string((int) volume) + "%"));
+				overlayVolume = (int) volume;
+				showOverlayWidget(volumeWidget);
 			} else if (sf::Keyboard::isKeyPressed(sf::Keyboard::Down) && !wasDown && useAudio) {
 				wasDown = true;
 				volume -= 10;
 				if (volume < 0) volume = 0;
 				audioBuffer.setVolume(volume);
 				
-				addNotification(new Notification("Volume lowered to " + to_string((int) volume) + "%"));
+				overlayVolume = (int) volume;
+				showOverlayWidget(volumeWidget);
 			}
 
 			if (!sf::Keyboard::isKeyPressed(sf::Keyboard::Up) && wasUp)	wasUp = false;
 			if (!sf::Keyboard::isKeyPressed(sf::Keyboard::Down) && wasDown)	wasDown = false;
-		}
 
-		// Read a specific frame from the video using the current time
-		capture.set(cv::CAP_PROP_POS_MSEC, millis.count() - start);
-		capture >> RGB;
-		
-		if (RGB.empty()) { // Check if video is over
-			onExit(0); //cout << "Capture Finished" << endl;
-		}
+			// Pinning the overlay widgets logic
+			if (sf::Keyboard::isKeyPressed(sf::Keyboard::I) && !wasInfo) {
+				wasInfo = true;
+				overlayPinned = !overlayPinned;
+			}
 
-		// Setup obtaining pixel data
-		uint8_t* pixelPtr = (uint8_t*)RGB.data;
-		int cn = RGB.channels();
-		Scalar_<uint8_t> bgrPixel;
+			if (!sf::Keyboard::isKeyPressed(sf::Keyboard::I) && wasInfo)	wasInfo = false;
+
+			// Opening the scrub preview logic; playback and audio pause while it's open
+			if (sf::Keyboard::isKeyPressed(sf::Keyboard::S) && !wasScrub && !liveMode) {
+				wasScrub = true;
+				scrubbing = true;
+				scrubStartPosition = millis.count() - start;
+				if (useAudio)
+					audioBuffer.pause();
 
-		// The video needs to be scaled to fit the terminal
-		float xScale = (float) RGB.cols / terminalSize.ws_col;
-		float yScale = (float) RGB.rows / terminalSize.ws_row;
+				int gridRows, gridCols, tileWidth, tileHeight;
+				scrubLayout(terminalSize.ws_row, terminalSize.ws_col, gridRows, gridCols, tileWidth, tileHeight);
+				cv::Rect picture = scrubPicture(tileWidth, tileHeight, frameWidth, frameHeight, cellAspect);
+				scrubber.setup(videoPath, overlayDurationMs, gridRows, gridCols, picture.width * 2, picture.height * 4);
+				scrubber.openAt(scrubStartPosition);
+			}
 
-		// Make sure the monochrome colors are correct if possible
-		if (COLOR_MODE == MODE_MONOCHROME) {
-			cout << "\033[37;40m";
+			if (!sf::Keyboard::isKeyPressed(sf::Keyboard::S) && wasScrub)	wasScrub = false;
 		}
-		cout << "\033[H\033[?25l"; // Sets cursor position to the top-left-most position and makes the cursor not blink for betting looking text rendering
-
-		int lastJ = -1;
-
-		// For every character in the terminal
-		for (int i = 0; i < terminalSize.ws_row; ++i) {
-			for (int j = 0; j < terminalSize.ws_col; ++j) {
-				// If notifications are rendered, don't overwrite them
-				if (i < 8) {
-					if (notificationsArr[i]) {
-						if (j < (notificationsArr[i]->text).length()) {
-							cout << "\033[1C";
-							continue;
-						}
-					}
-				}
-				
-				// Logic to prevent redrawing pixels that look the same between frames
-				// This is mostly useful for videos with borders of some sort (i.e. movies or music videos)
-				// Make sure not to do this to the first 8 lines to allow the notifications to be hidden
-				Vec3b pixelBottom = RGB.at<Vec3b>(
-					(int) (i * yScale) + ((int) yScale/2),
-					(int) (j * xScale)
-				);
 
-				int index = coordsToScreenBufferIndex(i, j, terminalSize.ws_row);
-				if (screenBufferInited && COLOR_MODE != MODE_DYNAMIC_RESOLUTION) {
-					if (i > 8 && abs(screenBuffer[index + 0] - pixelBottom[0]) + abs(screenBuffer[index + 1] - pixelBottom[1]) + abs(screenBuffer[index + 2] - pixelBottom[2]) < 2) {
-						continue;
-					}
-				}
-				screenBuffer[index + 0] = pixelBottom[0];
-				screenBuffer[index + 1] = pixelBottom[1];
-				screenBuffer[index + 2] = pixelBottom[2];
+		if (scrubbing) {
+			// Playback is paused, so just redraw the preview as thumbnails arrive
+			CellGrid& frameGrid = terminalWriter->backBuffer();
+			drawScrubPreview(frameGrid, scrubber, frameWidth, frameHeight, cellAspect);
+			overlayPositionMs = scrubber.timeOf(scrubber.selected);
+			showOverlayWidget(progressWidget);
+			compositeOverlay(frameGrid, useUnicode);
+			terminalWriter->submitFull(std::chrono::steady_clock::now(), wholeScreen);
+
+			updateOverlay(1000/FPS);
+			std::this_thread::sleep_for(std::chrono::milliseconds(1000/FPS));
+			continue;
+		}
 
-				if (lastJ != j - 1) { // If the last character printed wasn't the previous one
-					cout << "\033[" << (j - lastJ) - 1 << "C";
+		if (liveMode) {
+			// Wait a little for the newest frame; the keyboard still gets checked if nothing arrives
+			if (!liveInput.takeFrame(RGB, frameArrival, 100)) {
+				if (liveInput.finished) { // Check if the feed is over
+					onExit(0);
 				}
+				continue;
+			}
+		} else {
+			// Read a specific frame from the video using the current time
+			if (useFileDecoder) {
+				if (!fileDecoder.frameAt(millis.count() - start, RGB))	RGB = cv::Mat();
+			} else {
+				capture.set(cv::CAP_PROP_POS_MSEC, millis.count() - start);
+				capture >> RGB;
+			}
+			frameArrival = std::chrono::steady_clock::now();
+			
+			if (RGB.empty()) { // Check if video is over
+				onExit(0); //cout << "Capture Finished" << endl;
+			}
+		}
 
-				if (COLOR_MODE == MODE_DYNAMIC_RESOLUTION) {
-					// Obtain a second pixel
-					Vec3b pixelTop = RGB.at<Vec3b>(
-						(int) (i * yScale),
-						(int) (j * xScale)
-					);
-
-					Vec3b pixelTopR = RGB.at<Vec3b>(
-						(int) (i * yScale),
-						(int) (j * xScale) + ((int) xScale/2)
-					);
-
-					Vec3b pixelBottomR = RGB.at<Vec3b>(
-						(int) (i * yScale) + ((int) yScale/2),
-						(int) (j * xScale) + ((int) xScale/2)
-					);
-
-					// If color reduction is enabled, process that
-					if (COLOR_REDUCE > 0) {
-						float dither = (float) ((i + j) % 2) / 2.1;
-						pixelTop[0] = roundf(pixelTop[0] / COLOR_REDUCE + dither) * COLOR_REDUCE;
-						pixelTop[1] = roundf(pixelTop[1] / COLOR_REDUCE + dither) * COLOR_REDUCE;
-						pixelTop[2] = roundf(pixelTop[2] / COLOR_REDUCE + dither) * COLOR_REDUCE;
-						pixelBottom[0] = roundf(pixelBottom[0] / COLOR_REDUCE - dither) * COLOR_REDUCE;
-						pixelBottom[1] = roundf(pixelBottom[1] / COLOR_REDUCE - dither) * COLOR_REDUCE;
-						pixelBottom[2] = roundf(pixelBottom[2] / COLOR_REDUCE - dither) * COLOR_REDUCE;
-						pixelTopR[0] = roundf(pixelTopR[0] / COLOR_REDUCE + dither) * COLOR_REDUCE;
-						pixelTopR[1] = roundf(pixelTopR[1] / COLOR_REDUCE + dither) * COLOR_REDUCE;
-						pixelTopR[2] = roundf(pixelTopR[2] / COLOR_REDUCE + dither) * COLOR_REDUCE;
-						pixelBottomR[0] = roundf(pixelBottomR[0] / COLOR_REDUCE - dither) * COLOR_REDUCE;
-						pixelBottomR[1] = roundf(pixelBottomR[1] / COLOR_REDUCE - dither) * COLOR_REDUCE;
-						pixelBottomR[2] = roundf(pixelBottomR[2] / COLOR_REDUCE - dither) * COLOR_REDUCE;
-					}
-
-					float verticalSplit = similarityBetweenPixelsf(averagePixels(pixelTop, pixelTopR), averagePixels(pixelBottom, pixelBottomR));
-					float horizontalSplit = similarityBetweenPixelsf(averagePixels(pixelTop, pixelBottom), averagePixels(pixelTopR, pixelBottomR));
-					float diagonalSplit = similarityBetweenPixelsf(averagePixels(pixelTop, pixelBottomR), averagePixels(pixelTopR, pixelBottom));
-					float topLeft = similarityBetweenPixelsf(pixelTop, averagePixels(pixelTopR, pixelBottom, pixelBottomR)) * 0.035;
-					float topRight = similarityBetweenPixelsf(pixelTopR, averagePixels(pixelTop, pixelBottom, pixelBottomR)) * 0.035;
-					float bottomLeft = similarityBetweenPixelsf(pixelBottom, averagePixels(pixelTopR, pixelTop, pixelBottomR)) * 0.035;
-					float bottomRight = similarityBetweenPixelsf(pixelBottomR, averagePixels(pixelTop, pixelTopR, pixelBottom)) * 0.035;
-
-					if (
-						verticalSplit > horizontalSplit && verticalSplit > diagonalSplit &&
-						verticalSplit > topRight && verticalSplit > topLeft &&
-						verticalSplit > bottomLeft && verticalSplit > bottomRight
-					) {
-						float differences[7];
-						for (int k = 1; k < 8; k++) {
-							Vec3b pixel = RGB.at<Vec3b>(
-								(int) (i * yScale) + ((int) (((float) k) * yScale/8)),
-								(int) (j * xScale)
-							);
-
-							differences[k - 1] = similarityBetweenPixelsf(pixel, pixelTop);
-						}
-
-						int highestIndex;
-						float highestValue = -1;
-						for (int k = 1; k < 7; k++) {
-							float delta = abs(differences[k - 1] - differences[k]);
-							
-							if (delta > highestValue) {
-								highestValue = delta;
-								highestIndex = k;
-							}
-						}
-
-						cout << "\033[48;2;" << ((int) pixelTop[2]) << ";" << ((int) pixelTop[1]) << ";" << ((int) pixelTop[0]) << "m\033[38;2;" << ((int) pixelBottom[2]) << ";" << ((int) pixelBottom[1]) << ";" << ((int) pixelBottom[0]) << "m" << BLOCK_HEIGHT_GRADIENT[highestIndex];
-					} else if (
-						horizontalSplit > diagonalSplit &&
-						horizontalSplit > topRight && horizontalSplit > topLeft &&
-						horizontalSplit > bottomLeft && horizontalSplit > bottomRight
-					) {
-						Vec3b left = averagePixelsi(pixelTop, pixelBottom);
-						Vec3b right = averagePixelsi(pixelTopR, pixelBottomR);
-						//cout << "\033[38;2;" << ((int) left[2]) << ";" << ((int) left[1]) << ";" << ((int) left[0]) << "m\033[48;2;" << ((int) right[2]) << ";" << ((int) right[1]) << ";" << ((int) right[0]) << "m▌";
-
-						float differences[7];
-						for (int k = 1; k < 8; k++) {
-							Vec3b pixel = RGB.at<Vec3b>(
-								(int) (i * yScale),
-								(int) (j * xScale) + ((int) (((float) k) * yScale/16))
-							);
-
-							differences[k - 1] = similarityBetweenPixelsf(pixel, left);
-						}
-
-						int highestIndex;
-						float highestValue = -1;
-						for (int k = 1; k < 7; k++) {
-							float delta = abs(differences[k - 1] - differences[k]);
-							
-							if (delta > highestValue) {
-								highestValue = delta;
-								highestIndex = k;
-							}
-						}
-
-						cout << "\033[48;2;" << ((int) right[2]) << ";" << ((int) right[1]) << ";" << ((int) right[0]) << "m\033[38;2;" << ((int) left[2]) << ";" << ((int) left[1]) << ";" << ((int) left[0]) << "m" << BLOCK_WIDTH_GRADIENT[highestIndex];
-					} else if (
-						diagonalSplit > topRight && diagonalSplit > topLeft &&
-						diagonalSplit > bottomLeft && diagonalSplit > bottomRight
-					) {
-						Vec3b B = averagePixelsi(pixelTop, pixelBottomR);
-						Vec3b A = averagePixelsi(pixelTopR, pixelBottom);
-						cout << "\033[38;2;" << ((int) A[2]) << ";" << ((int) A[1]) << ";" << ((int) A[0]) << "m\033[48;2;" << ((int) B[2]) << ";" << ((int) B[1]) << ";" << ((int) B[0]) << "m▞";
-					} else if (
-						topRight > topLeft && topRight > bottomLeft && topRight > bottomRight
-					) {
-						Vec3b A = averagePixelsi(pixelTop, pixelBottom, pixelBottomR);
-						cout << "\033[48;2;" << ((int) A[2]) << ";" << ((int) A[1]) << ";" << ((int) A[0]) << "m\033[38;2;" << ((int) pixelTopR[2]) << ";" << ((int) pixelTopR[1]) << ";" << ((int) pixelTopR[0]) << "m▝";
-					} else if (
-						topLeft > bottomLeft && topLeft > bottomRight
-					) {
-						Vec3b A = averagePixelsi(pixelTopR, pixelBottom, pixelBottomR);
-						cout << "\033[48;2;" << ((int) A[2]) << ";" << ((int) A[1]) << ";" << ((int) A[0]) << "m\033[38;2;" << ((int) pixelTop[2]) << ";" << ((int) pixelTop[1]) << ";" << ((int) pixelTop[0]) << "m▘";
-					} else if (
-						bottomLeft > bottomRight
-					) {
-						Vec3b A = averagePixelsi(pixelTopR, pixelTop, pixelBottomR);
-						cout << "\033[48;2;" << ((int) A[2]) << ";" << ((int) A[1]) << ";" << ((int) A[0]) << "m\033[38;2;" << ((int) pixelBottom[2]) << ";" << ((int) pixelBottom[1]) << ";" << ((int) pixelBottom[0]) << "m▖";
-					} else {
-						Vec3b A = averagePixelsi(pixelTopR, pixelTop, pixelBottom);
-						cout << "\033[48;2;" << ((int) A[2]) << ";" << ((int) A[1]) << ";" << ((int) A[0]) << "m\033[38;2;" << ((int) pixelBottomR[2]) << ";" << ((int) pixelBottomR[1]) << ";" << ((int) pixelBottomR[0]) << "m▗";
-					}
-
-				} else if (COLOR_MODE == MODE_COLOR) {
-					// Obtain a second pixel
-					Vec3b pixelTop = RGB.at<Vec3b>(
-						(int) (i * yScale),
-						(int) (j * xScale)
-					);
-
-					// If color reduction is enabled, process that
-					if (COLOR_REDUCE > 0) {
-						float dither = (float) ((i + j) % 2) / 2.1;
-						pixelTop[0] = roundf(pixelTop[0] / COLOR_REDUCE + dither) * COLOR_REDUCE;
-						pixelTop[1] = roundf(pixelTop[1] / COLOR_REDUCE + dither) * COLOR_REDUCE;
-						pixelTop[2] = roundf(pixelTop[2] / COLOR_REDUCE + dither) * COLOR_REDUCE;
-						pixelBottom[0] = roundf(pixelBottom[0] / COLOR_REDUCE - dither) * COLOR_REDUCE;
-						pixelBottom[1] = roundf(pixelBottom[1] / COLOR_REDUCE - dither) * COLOR_REDUCE;
-						pixelBottom[2] = roundf(pixelBottom[2] / COLOR_REDUCE - dither) * COLOR_REDUCE;
-					}
-
-					// Set the background color to the top pixel, and the foreground color to the bottom pixel and print a half-block character
-					// This gives the illusion of having double vertical resolution, since a block character is usually 1:1 and a character 1:2
-					if (similarityBetweenPixels(pixelTop, pixelBottom) == 0) { // If the top and bottom pixels are the same, don't change both the background and foreground color
-						cout << "\033[48;2;" << ((int) pixelTop[2]) << ";" << ((int) pixelTop[1]) << ";" << ((int) pixelTop[0]) << "m ";
-					} else {
-						if (useUnicode) {
-							cout << "\033[48;2;" << ((int) pixelTop[2]) << ";" << ((int) pixelTop[1]) << ";" << ((int) pixelTop[0]) << "m\033[38;2;" << ((int) pixelBottom[2]) << ";" << ((int) pixelBottom[1]) << ";" << ((int) pixelBottom[0]) << "m▄";
-						} else {
-							cout << "\033[48;2;" << ((int) pixelTop[2]) << ";" << ((int) pixelTop[1]) << ";" << ((int) pixelTop[0]) << "m\033[38;2;" << ((int) pixelBottom[2]) << ";" << ((int) pixelBottom[1]) << ";" << ((int) pixelBottom[0]) << "m_";
-						}
-					}
-				} else if (COLOR_MODE == MODE_MONOCHROME) {
-					Vec3b pixel = RGB.at<Vec3b>(
-						(int) (i * yScale),
-						(int) (j * xScale)
-					);
-
-					Vec3b pixelUp = Vec3b(255, 255, 255);
-					if (i != 0) {
-						pixelUp = RGB.at<Vec3b>(
-							(int) (i * yScale) - ((int) yScale/2),
-							(int) (j * xScale)
-						);
-					}
-
-					Vec3b pixelDown = Vec3b(255, 255, 255);
-					if (i + 1 != terminalSize.ws_row) {
-						Vec3b pixelDown = RGB.at<Vec3b>(
-							(int) (i * yScale) + ((int) yScale/2),
-							(int) (j * xScale)
-						);
-					}
-
-					// By mixing the colors like this, it closer mimics the grayscale color human eyes see, created a better looking grayscale
-					float grayScale = ((0.2125 * pixel[0]) + (0.7154 * pixel[1]) + (0.0721 * pixel[2]));
-					float grayScaleUp = ((0.2125 * pixelUp[0]) + (0.7154 * pixelUp[1]) + (0.0721 * pixelUp[2]));
-					float grayScaleDown = ((0.2125 * pixelDown[0]) + (0.7154 * pixelDown[1]) + (0.0721 * pixelDown[2]));
-
-					if (useUnicode) {
-						if (grayScale > 240 && grayScaleUp < 16) {
-							cout << "▄";
-							continue;
-						} else if (grayScale > 240 && grayScaleDown < 16) {
-							cout << "▀";
-							continue;
-						}
-					} else {
-						if (grayScale > 240 && grayScaleUp < 16) {
-							cout << ",";
-							continue;
-						} else if (grayScale > 240 && grayScaleDown < 16) {
-							cout << "'";
-							continue;
-						}
-					}
-
-					// Normalize the values 0-5 and dither
-					grayScale /= 25.6;
-					if (((int) round(grayScale)) % 2 == 1) {
-						if ((i + j) % 2 == 0 && grayScale - 0.4 > round(grayScale)) {
-							grayScale = round(grayScale - 1);
-						} else {
-							grayScale = round(grayScale + 1);
-						}
-					}
-
-					grayScale /= 2;
-
-					// Convert a value to a character of a certain brightness
-					string character;
-					int grayScaleInt = (int) grayScale;
-					if (grayScaleInt == 0) {
-						character = " ";
-					} else if (grayScaleInt == 1) {
-						character = ".";
-					} else if (grayScaleInt == 2) {
-						character = "░";
-					} else if (grayScaleInt == 3) {
-						character = "▒";
-					} else if (grayScaleInt == 4) {
-						character = "▓";
-					} else {
-						character = "█";
-					}
-
-					cout << character;
-
-					// (0.2125 * color.r) + (0.7154 * color.g) + (0.0721 * color.b)
-				} else if (COLOR_MODE == MODE_256) {
-					// Obtain two pixels
-					Vec3b pixelTop = RGB.at<Vec3b>(
-						(int) (i * yScale),
-						(int) (j * xScale)
-					);
-
-					// Normalize colors 0-5
-					pixelTop[0] = (j % 2 == 1) ? round(pixelTop[0] / 51) : floor(pixelTop[0] / 51);
-					pixelTop[1] = (j % 2 == 1) ? round(pixelTop[1] / 51) : floor(pixelTop[1] / 51);
-					pixelTop[2] = (j % 2 == 1) ? round(pixelTop[2] / 51) : floor(pixelTop[2] / 51);
-					pixelBottom[0] = (j % 2 == 0) ? round(pixelBottom[0] / 51) : floor(pixelBottom[0] / 51);
-					pixelBottom[1] = (j % 2 == 0) ? round(pixelBottom[1] / 51) : floor(pixelBottom[1] / 51);
-					pixelBottom[2] = (j % 2 == 0) ? round(pixelBottom[2] / 51) : floor(pixelBottom[2] / 51);
-
-					int topColor;
-					int bottomColor;
-
-					// The 256 color palette has extra shades of gray. This code uses that.
-					if ((int) pixelTop[0] == (int) pixelTop[1] && (int) pixelTop[1] == (int) pixelTop[2]) {
-						topColor = round(pixelTop[0] * 4.6) + 232;
-					} else {
-						topColor = pixelTop[2] + (pixelTop[1] * 6) + (pixelTop[0] * 36) + 16;
-					}
-					if ((int) pixelBottom[0] == (int) pixelBottom[1] && (int) pixelBottom[1] == (int) pixelBottom[2]) {
-						bottomColor = round(pixelBottom[0] * 4.6) + 232;
-					} else {
-						bottomColor = pixelBottom[2] + (pixelBottom[1] * 6) + (pixelBottom[0] * 36) + 16;
-					}
-
-					// Set the background color to the top pixel, and the foreground color to the bottom pixel and print a half-block character
-					// This gives the illusion of having double vertical resolution, since a block character is usually 1:1 and a character 1:2
-					if (useUnicode) {
-						cout << "\033[48;5;" << topColor << "m\033[38;5;" << bottomColor << "m▄";
-					} else {
-						cout << "\033[48;5;" << topColor << "m\033[38;5;" << bottomColor << "m_";
-					}
-				} else if (COLOR_MODE == MODE_ASCII_ART) {
-					Vec3b pixel = RGB.at<Vec3b>(
-						(int) (i * yScale),
-						(int) (j * xScale)
-					);
-
-					Vec3b pixelUp = Vec3b(255, 255, 255);
-					if (i != 0) {
-						pixelUp = RGB.at<Vec3b>(
-							(int) (i * yScale) - ((int) yScale/2),
-							(int) (j * xScale)
-						);
-					}
-
-					Vec3b pixelDown = Vec3b(255, 255, 255);
-					if (i + 1 != terminalSize.ws_row) {
-						Vec3b pixelDown = RGB.at<Vec3b>(
-							(int) (i * yScale) + ((int) yScale/2),
-							(int) (j * xScale)
-						);
-					}
-
-					// By mixing the colors like this, it closer mimics the grayscale color human eyes see, created a better looking grayscale
-					float grayScale = ((0.2125 * pixel[0]) + (0.7154 * pixel[1]) + (0.0721 * pixel[2]));
-
-					// Normalize the values 0-14 and dither
-					grayScale /= 8.534;
-					if (((int) round(grayScale)) % 2 == 1) {
-						if ((i + j) % 2 == 0 && grayScale - 0.4 > round(grayScale)) {
-							grayScale = round(grayScale - 1);
-						} else {
-							grayScale = round(grayScale + 1);
-						}
-					}
-
-					grayScale /= 2;
-
-					cout << ASCII_ART_GRADIENT[(int) grayScale];
-
-					// (0.2125 * color.r) + (0.7154 * color.g) + (0.0721 * color.b)
-				} else if (COLOR_MODE == MODE_ASCII_FULL) {
-					Vec3b pixel = RGB.at<Vec3b>(
-						(int) (i * yScale),
-						(int) (j * xScale)
-					);
-
-					Vec3b pixelUp = Vec3b(255, 255, 255);
-					if (i != 0) {
-						pixelUp = RGB.at<Vec3b>(
-							(int) (i * yScale) - ((int) yScale/2),
-							(int) (j * xScale)
-						);
-					}
-
-					Vec3b pixelDown = Vec3b(255, 255, 255);
-					if (i + 1 != terminalSize.ws_row) {
-						Vec3b pixelDown = RGB.at<Vec3b>(
-							(int) (i * yScale) + ((int) yScale/2),
-							(int) (j * xScale)
-						);
-					}
-
-					// By mixing the colors like this, it closer mimics the grayscale color human eyes see, created a better looking grayscale
-					float grayScale = ((0.2125 * pixel[0]) + (0.7154 * pixel[1]) + (0.0721 * pixel[2]));
-
-					// Normalize the values 0-94 and dither
-					grayScale /= 1.347368421;
-					if (((int) round(grayScale)) % 2 == 1) {
-						if ((i + j) % 2 == 0 && grayScale - 0.4 > round(grayScale)) {
-							grayScale = round(grayScale - 1);
-						} else {
-							grayScale = round(grayScale + 1);
-						}
-					}
-
-					grayScale /= 2;
-
-					cout << ASCII_FULL_GRADIENT[(int) grayScale];
+		FrameView frame(RGB, frameHeight);
+		framePath = frame.format;
 
-					// (0.2125 * color.r) + (0.7154 * color.g) + (0.0721 * color.b)
-				}
+		// Work out where the video goes whenever the video's shape or its black bars change
+		bool geometryChanged = crop.area() == 0 || crop.x + crop.width > frame.width || crop.y + crop.height > frame.height;
+		if (detectLetterbox && letterbox.update(frame, millis.count())) {
+			geometryChanged = true;
+		}
 
-				// Remember where the last character was printed
-				lastJ = j;
+		if (geometryChanged) {
+			crop = detectLetterbox ? letterbox.crop : cv::Rect(0, 0, frame.width, frame.height);
+			if (stretchVideo) {
+				viewport = cv::Rect(0, 0, terminalSize.ws_col, terminalSize.ws_row);
+			} else {
+				viewport = fitViewport(crop.width, crop.height, terminalSize.ws_col, terminalSize.ws_row, cellAspect);
 			}
 
-			// If this isn't the last row, go to the next line and reset lastJ
-			if (i + 1 != terminalSize.ws_row) {
-				cout << endl;
-				lastJ = -1;
-			}
+			paintBars(videoGrid, viewport);
+			changingRegion(region, viewport, terminalSize.ws_row, terminalSize.ws_col);
+			terminalWriter->requestFullFrame();
+			screenBuffer.assign(viewport.area() * 3, 0);
+			screenBufferInited = false;
+
+			if (debugMode)
+				addNotification("Showing " + to_string(crop.width) + "x" + to_string(crop.height) + " in " + to_string(viewport.width) + "x" + to_string(viewport.height) + " cells");
 		}
 
-		// Reset the color
-		cout << "\033[0m";
+		rasterizeFrame(frame.crop(crop), videoGrid, viewport, screenBuffer.data(), screenBufferInited);
 
 		// Since the screen has been drawn, the screenBuffer must be initialized by now
 		screenBufferInited = true;
 
-		// Process and draw notifications
-		updateNotifications(2, 1000/FPS);
+		// Draw the overlay over a copy of the video, so the video underneath comes back once the overlay is gone
+		// The bars only need copying when the writer wants a full frame; otherwise just the region that can change is
+		CellGrid& frameGrid = terminalWriter->backBuffer();
+		bool fullFrame = terminalWriter->needsFullFrame();
+		if (fullFrame) {
+			frameGrid.cells = videoGrid.cells;
+		} else {
+			copyCells(videoGrid, frameGrid, region);
+		}
+		overlayPositionMs = millis.count() - start;
+		compositeOverlay(frameGrid, useUnicode);
+
+		// Hand the frame over to the writer thread; if it's still busy, this replaces whatever frame it hadn't gotten to
+		if (fullFrame) {
+			terminalWriter->submitFull(frameArrival, region);
+		} else {
+			terminalWriter->submit(frameArrival);
+		}
+
+		if (debugMode && millis.count() - lastStatsMillis >= 1000) {
+			long elapsed = millis.count() - lastStatsMillis;
+			long blocked = terminalWriter->blockedMicros;
+			long written = terminalWriter->framesWritten;
+			long dropped = terminalWriter->framesDropped;
+
+			long latencyCount = terminalWriter->latencyCount.exchange(0);
+			long latencyMicros = terminalWriter->latencyMicros.exchange(0);
+			long latencyMaxMicros = terminalWriter->latencyMaxMicros.exchange(0);
+			long liveDropped = liveInput.framesDropped;
+
+			overlayStatsLength = snprintf(overlayStatsText, sizeof(overlayStatsText), " %s path, tty blocked %ld ms/s, %ld fps written, %ld dropped, %ld cells deferred, latency %ld/%ld ms ",
+				framePathName(framePath), (blocked - lastBlockedMicros) / elapsed, (written - lastFramesWritten) * 1000 / elapsed, dropped + liveDropped - lastFramesDropped - lastLiveDropped,
+				(long) terminalWriter->cellsDeferred, latencyCount > 0 ? latencyMicros / latencyCount / 1000 : 0, latencyMaxMicros / 1000);
+			overlayStatsLength = min(overlayStatsLength, (int) sizeof(overlayStatsText) - 1);
+
+			lastStatsMillis = millis.count();
+			lastBlockedMicros = blocked;
+			lastFramesWritten = written;
+			lastFramesDropped = dropped;
+			lastLiveDropped = liveDropped;
+		}
+
+		// Count down the notifications and widgets
+		updateOverlay(liveMode ? millis.count() - lastFrameMillis : 1000/FPS);
+		lastFrameMillis = millis.count();
 
 
 		// Wait until one frame's worth of time has passed, measured from when the current frame began
-		while (true) {
+		// Live feeds are paced by the frames arriving instead
+		while (!liveMode) {
 			auto timeEndOfFrame = std::chrono::system_clock::now();
 			auto since_epochEndOfFrame = timeEndOfFrame.time_since_epoch();
 		
@@ -1,77 +1,57 @@
-#include <SFML/Audio.hpp>
 #include <stdio.h>
+#include <string.h>
 #include <iostream>
 
 using namespace std;
 
+const int NOTIFICATION_SLOTS = 8;
+const int NOTIFICATION_MAX_LENGTH = 63;
+const int NOTIFICATION_DURATION = 1500;
+
 class Notification {
 	public:
-		string text;
+		char text[NOTIFICATION_MAX_LENGTH + 1];
+		int length;
 		int msLeft;
 
-		Notification(std::string text) {
-			this->text = text;
-			this->msLeft = 1500;
-		};
-
-		string getText(bool colorful) {
-			if (colorful) {
-				return "\033[37;40m" + (this->text) + "\033[0m";
-			}
-			return (this->text);
+		void set(const string& text) {
+			this->length = min((int) text.length(), NOTIFICATION_MAX_LENGTH);
+			memcpy(this->text, text.c_str(), this->length);
+			this->text[this->length] = 0;
+			this->msLeft = NOTIFICATION_DURATION;
 		};
 };
 
 // Storage for notifications, limited to 8 displayed at a time
-Notification* notificationsArr[8] = {nullptr, nullptr, nullptr, nullptr, nullptr, nullptr, nullptr, nullptr};
-
-void addNotification(Notification* notification) {
-	// Check if an available slot exists; if so, use it
-	for (int i = 0; i < 8; i++) {
-		if (!notificationsArr[i]) {
-			notificationsArr[i] = notification;
-			return;
+// The slots are stored by value and kept in display order, so adding a notification never allocates
+Notification notificationsArr[NOTIFICATION_SLOTS];
+int notificationCount = 0;
+
+void addNotification(const string& text) {
+	// If no available slot exists, drop the oldest notification and shift the rest up by one
+	if (notificationCount == NOTIFICATION_SLOTS) {
+		for (int i = 0; i < NOTIFICATION_SLOTS - 1; i++) {
+			notificationsArr[i] = notificationsArr[i + 1];
 		}
+		notificationCount--;
 	}
 
-	// If no available slot exists, free the first slot and shift the rest down by one
-	free(notificationsArr[0]);
-	for (int i = 0; i < 7; i++) {
-		notificationsArr[i] = notificationsArr[i + 1];
-	}
-	// Then, make the last slot the new notification
-	notificationsArr[7] = notification;
+	notificationsArr[notificationCount].set(text);
+	notificationCount++;
 }
 
-void updateNotifications(int print, int msElapsed) {
-	for (int i = 0; i < 8; i++) {
-		if (!notificationsArr[i])	continue; // Make sure this notification slot is not nullptr
-
-		notificationsArr[i]->msLeft -= msElapsed;
+void updateNotifications(int msElapsed) {
+	int kept = 0;
+	for (int i = 0; i < notificationCount; i++) {
+		notificationsArr[i].msLeft -= msElapsed;
 
-		// If a notification has expired
-		if (notificationsArr[i]->msLeft <= 0) {
-			free(notificationsArr[i]);
-
-			// Shift down the rest of the notifications
-			for (int j = i; j < 7; j++) {
-				notificationsArr[j] = notificationsArr[j + 1];
-			}
-			// The last pointer shouldn't be freed since slot 6 now references it
-			notificationsArr[7] = nullptr;
-		}
-	}
-
-	// If printing is enabled
-	if (print != 0) {
-		cout << "\033[H"; // Set cursor to top-left
-		for (int i = 0; i < 8; i++) {
-			
-			// If this slot is not nullptr
-			if (notificationsArr[i]) {
-				cout << notificationsArr[i]->getText(print == 2);
+		// Expired notifications are dropped by shifting the remaining ones over them
+		if (notificationsArr[i].msLeft > 0) {
+			if (kept != i) {
+				notificationsArr[kept] = notificationsArr[i];
 			}
-			cout << endl << "\r";
+			kept++;
 		}
 	}
-}
\ No newline at end of file
+	notificationCount = kept;
+}
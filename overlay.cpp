@@ -0,0 +1,173 @@
+#include <string>
+
+#include "cells.cpp"
+#include "notif.cpp"
+
+using namespace std;
+
+const int OVERLAY_WIDGET_DURATION = 2000;
+const int VOLUME_BAR_SEGMENTS = 10;
+
+// The overlay only ever draws in this many rows at the top (notifications, volume, mode) and bottom (stats, progress)
+const int OVERLAY_TOP_ROWS = NOTIFICATION_SLOTS;
+const int OVERLAY_BOTTOM_ROWS = 2;
+
+// The overlay is drawn over the video cells once per frame, after the video has been rasterized and before it is encoded
+// Everything here lives in fixed storage so that drawing the overlay never allocates
+
+// Widgets are only shown for a short while after something changes them, unless the overlay is pinned
+struct OverlayWidget {
+	int msLeft;
+};
+
+OverlayWidget progressWidget = {0};
+OverlayWidget volumeWidget = {0};
+OverlayWidget modeWidget = {0};
+bool overlayPinned = false;
+
+long overlayPositionMs = 0;
+long overlayDurationMs = 0;
+int overlayVolume = 100;
+const char* overlayModeName = "";
+
+// Statistics line shown above the progress bar when --debug is used
+bool overlayStatsEnabled = false;
+char overlayStatsText[128] = "";
+int overlayStatsLength = 0;
+
+inline void showOverlayWidget(OverlayWidget& widget) {
+	widget.msLeft = OVERLAY_WIDGET_DURATION;
+}
+
+inline bool overlayWidgetVisible(const OverlayWidget& widget) {
+	return overlayPinned || widget.msLeft > 0;
+}
+
+void updateOverlay(int msElapsed) {
+	updateNotifications(msElapsed);
+
+	progressWidget.msLeft -= msElapsed;
+	volumeWidget.msLeft -= msElapsed;
+	modeWidget.msLeft -= msElapsed;
+}
+
+// Writes a timestamp as m:ss or h:mm:ss into buffer, returning its length
+int formatTimestamp(char* buffer, long ms) {
+	if (ms < 0) ms = 0;
+	long seconds = ms / 1000;
+	if (seconds >= 3600) {
+		return sprintf(buffer, "%ld:%02ld:%02ld", seconds / 3600, (seconds / 60) % 60, seconds % 60);
+	}
+	return sprintf(buffer, "%ld:%02ld", seconds / 60, seconds % 60);
+}
+
+inline void drawOverlayGlyph(CellGrid& grid, int row, int col, const char* glyph) {
+	if (row < 0 || row >= grid.rows || col < 0 || col >= grid.cols) return;
+
+	Cell& cell = grid.at(row, col);
+	setCellGlyph(cell, glyph);
+	setCellBasic(cell, 7, 0);
+	cell.overlay = 1;
+}
+
+// Draws white-on-black text, clipped to the screen, and returns the column after it
+int drawOverlayText(CellGrid& grid, int row, int col, const char* text, int length) {
+	if (row < 0 || row >= grid.rows) return col + length;
+
+	for (int k = 0; k < length; k++) {
+		if (col + k < 0 || col + k >= grid.cols) continue;
+
+		Cell& cell = grid.at(row, col + k);
+		setCellGlyph(cell, text[k]);
+		setCellBasic(cell, 7, 0);
+		cell.overlay = 1;
+	}
+	return col + length;
+}
+
+// Bottom row: "1:23 / 4:56" followed by a bar filling the rest of the width
+// Live feeds have no duration, so only show how long they've been playing
+void drawProgressBar(CellGrid& grid, bool useUnicode) {
+	char text[48];
+	int length = 0;
+	text[length++] = ' ';
+
+	if (overlayDurationMs <= 0) {
+		length += sprintf(text + length, "LIVE ");
+		length += formatTimestamp(text + length, overlayPositionMs);
+		text[length++] = ' ';
+		drawOverlayText(grid, grid.rows - 1, 0, text, length);
+		return;
+	}
+
+	length += formatTimestamp(text + length, overlayPositionMs);
+	length += sprintf(text + length, " / ");
+	length += formatTimestamp(text + length, overlayDurationMs);
+	text[length++] = ' ';
+
+	int row = grid.rows - 1;
+	int col = drawOverlayText(grid, row, 0, text, length);
+
+	int barWidth = grid.cols - col - 1;
+	if (barWidth <= 0) return;
+
+	int filled = 0;
+	if (overlayDurationMs > 0) {
+		filled = (int) ((double) overlayPositionMs / overlayDurationMs * barWidth);
+		filled = max(0, min(barWidth, filled));
+	}
+
+	for (int k = 0; k < barWidth; k++) {
+		if (useUnicode) {
+			drawOverlayGlyph(grid, row, col + k, k < filled ? "█" : "░");
+		} else {
+			drawOverlayGlyph(grid, row, col + k, k < filled ? "=" : "-");
+		}
+	}
+	drawOverlayText(grid, row, grid.cols - 1, " ", 1);
+}
+
+// Top-right corner: "Vol 80%" followed by a small bar
+void drawVolumeIndicator(CellGrid& grid, bool useUnicode) {
+	char text[16];
+	int length = sprintf(text, " Vol %3d%% ", overlayVolume);
+
+	int col = grid.cols - length - VOLUME_BAR_SEGMENTS - 1;
+	col = drawOverlayText(grid, 0, col, text, length);
+
+	int filled = (overlayVolume + (100 / VOLUME_BAR_SEGMENTS) / 2) / (100 / VOLUME_BAR_SEGMENTS);
+	for (int k = 0; k < VOLUME_BAR_SEGMENTS; k++) {
+		if (useUnicode) {
+			drawOverlayGlyph(grid, 0, col + k, k < filled ? "▮" : "▯");
+		} else {
+			drawOverlayGlyph(grid, 0, col + k, k < filled ? "|" : ".");
+		}
+	}
+	drawOverlayText(grid, 0, grid.cols - 1, " ", 1);
+}
+
+// Top-right corner, under the volume: the active color mode
+void drawModeIndicator(CellGrid& grid) {
+	char text[32];
+	int length = snprintf(text, sizeof(text), " Mode: %s ", overlayModeName);
+	length = min(length, (int) sizeof(text) - 1);
+
+	drawOverlayText(grid, 1, grid.cols - length, text, length);
+}
+
+// Bottom-left, above the progress bar: the debug statistics
+void drawStats(CellGrid& grid) {
+	drawOverlayText(grid, grid.rows - 2, 0, overlayStatsText, overlayStatsLength);
+}
+
+// Draws every visible overlay layer into grid: widgets first, then notifications on top
+void compositeOverlay(CellGrid& grid, bool useUnicode) {
+	if (overlayWidgetVisible(progressWidget))	drawProgressBar(grid, useUnicode);
+	if (overlayWidgetVisible(volumeWidget))	drawVolumeIndicator(grid, useUnicode);
+	if (overlayWidgetVisible(modeWidget))	drawModeIndicator(grid);
+	if (overlayStatsEnabled)	drawStats(grid);
+
+	for (int i = 0; i < notificationCount && i < grid.rows; i++) {
+		drawOverlayText(grid, i, 0, notificationsArr[i].text, notificationsArr[i].length);
+	}
+}
@@ -0,0 +1,267 @@
+#include <opencv2/opencv.hpp>
+#include <condition_variable>
+#include <deque>
+#include <list>
+#include <map>
+#include <mutex>
+#include <set>
+#include <sstream>
+#include <thread>
+#include <vector>
+#include <stdio.h>
+
+#include "interrupt.cpp"
+#include "shell.cpp"
+
+using namespace std;
+using namespace cv;
+
+const int SCRUB_CACHE_SIZE = 64;
+const int SCRUB_MAX_WORKERS = 4;
+const long SCRUB_MIN_STEP_MS = 5000;
+
+// A decoded thumbnail and where its keyframe actually is, which can be well before the position it was asked for
+struct Thumbnail {
+	Mat image;
+	long keyframeMs;
+};
+
+// Holds the most recently used thumbnails, keyed by their position in the video
+// A thumbnail that couldn't be decoded is stored with an empty image so it isn't tried again
+class ThumbnailCache {
+	public:
+		bool get(long positionMs, Thumbnail& thumbnail) {
+			auto found = entries.find(positionMs);
+			if (found == entries.end())	return false;
+
+			// Move it to the front of the list as the most recently used
+			order.splice(order.begin(), order, found->second.second);
+			thumbnail = found->second.first;
+			return true;
+		};
+
+		bool contains(long positionMs) {
+			return entries.count(positionMs) > 0;
+		};
+
+		void put(long positionMs, const Thumbnail& thumbnail) {
+			if (entries.count(positionMs))	return;
+
+			if ((int) entries.size() >= SCRUB_CACHE_SIZE) {
+				entries.erase(order.back());
+				order.pop_back();
+			}
+			order.push_front(positionMs);
+			entries[positionMs] = make_pair(thumbnail, order.begin());
+		};
+
+	private:
+		list<long> order;
+		map<long, pair<Thumbnail, list<long>::iterator>> entries;
+};
+
+// Decodes thumbnails for the scrub preview on a pool of worker threads
+// Each thumbnail is the keyframe nearest to its position, decoded by ffmpeg straight at thumbnail size, which is
+// much cheaper than an exact seek. The keyframe's own time is kept, since that's where jumping to it should go. The layout of the preview and which thumbnail is selected also live here.
+class Scrubber {
+	public:
+		long stepMs; // Time between neighbouring thumbnails
+		int gridRows;
+		int gridCols;
+		int selected; // Index of the selected thumbnail; thumbnail k is at k * stepMs
+		int first; // Index of the thumbnail in the top-left of the grid
+
+		Scrubber() {
+			this->started = false;
+			this->stepMs = SCRUB_MIN_STEP_MS;
+			this->gridRows = 1;
+			this->gridCols = 1;
+			this->selected = 0;
+			this->first = 0;
+			this->lastIndex = 0;
+		};
+
+		// Must be called before anything else; starts the workers the first time
+		void setup(const string& videoPath, long durationMs, int gridRows, int gridCols, int thumbnailWidth, int thumbnailHeight) {
+			{
+				// Workers from the last time may still be decoding with these
+				lock_guard<mutex> lock(guard);
+				this->videoPath = videoPath;
+				this->thumbnailWidth = thumbnailWidth;
+				this->thumbnailHeight = thumbnailHeight;
+			}
+			this->gridRows = gridRows;
+			this->gridCols = gridCols;
+
+			// Roughly 60 thumbnails cover the whole video, in whole seconds
+			this->stepMs = max(SCRUB_MIN_STEP_MS, durationMs / 60 / 1000 * 1000);
+			this->lastIndex = max(0L, (durationMs - 1) / stepMs);
+
+			if (started)	return;
+			started = true;
+
+			int workers = max(1, min(SCRUB_MAX_WORKERS, (int) std::thread::hardware_concurrency()));
+			for (int k = 0; k < workers; k++) {
+				std::thread(&Scrubber::work, this).detach();
+			}
+		};
+
+		// Centers the grid on the thumbnail closest to positionMs
+		void openAt(long positionMs) {
+			selected = min(lastIndex, (int) max(0L, (positionMs + stepMs / 2) / stepMs));
+			first = max(0, selected - (gridRows * gridCols) / 2);
+			first -= first % gridCols;
+			scrollToSelected();
+			requestVisible();
+		};
+
+		// Moves the selection, scrolling the grid a row at a time when it leaves the screen
+		void move(int delta) {
+			selected = max(0, min(lastIndex, selected + delta));
+			scrollToSelected();
+			requestVisible();
+		};
+
+		long positionOf(int index) {
+			return index * stepMs;
+		};
+
+		bool exists(int index) {
+			return index >= 0 && index <= lastIndex;
+		};
+
+		// Gets a thumbnail if it has been decoded. thumbnail is left empty if it couldn't be
+		bool get(int index, Mat& thumbnail) {
+			lock_guard<mutex> lock(guard);
+			Thumbnail found;
+			if (!cache.get(positionOf(index), found))	return false;
+			thumbnail = found.image;
+			return true;
+		};
+
+		// Where the picture shown for a thumbnail is in the video, so jumping there shows the same picture
+		// Until it's decoded that isn't known yet, so it's the thumbnail's position
+		long timeOf(int index) {
+			lock_guard<mutex> lock(guard);
+			Thumbnail found;
+			if (!cache.get(positionOf(index), found) || found.image.empty())	return positionOf(index);
+			return found.keyframeMs;
+		};
+
+	private:
+		bool started;
+		int lastIndex;
+
+		// Read by the workers, so only touched while holding guard
+		string videoPath;
+		int thumbnailWidth;
+		int thumbnailHeight;
+
+		ThumbnailCache cache;
+		deque<long> queue; // Positions waiting to be decoded, most wanted first
+		set<long> inProgress;
+		mutex guard;
+		condition_variable wake;
+
+		void scrollToSelected() {
+			while (selected < first)	first -= gridCols;
+			while (selected >= first + gridRows * gridCols)	first += gridCols;
+			first = max(0, first);
+		};
+
+		// Replaces the queue with what's on screen (selection first) and a row either side of it
+		// Anything that scrolled away before a worker got to it is simply never decoded
+		void requestVisible() {
+			vector<long> wanted;
+			wanted.push_back(positionOf(selected));
+			for (int index = first - gridCols; index < first + (gridRows + 1) * gridCols; index++) {
+				if (exists(index) && index != selected) {
+					wanted.push_back(positionOf(index));
+				}
+			}
+
+			{
+				lock_guard<mutex> lock(guard);
+				queue.clear();
+				for (long positionMs : wanted) {
+					if (!cache.contains(positionMs) && !inProgress.count(positionMs)) {
+						queue.push_back(positionMs);
+					}
+				}
+			}
+			wake.notify_all();
+		};
+
+		// The pixels come out first, on fd 3 of the shell. ffmpeg also writes a framecrc line for the same frame, which is
+		// held back and printed after them; with -copyts its timestamp is where the keyframe really is in the video
+		Thumbnail decode(long positionMs, const string& path, int width, int height) {
+			Thumbnail thumbnail;
+			thumbnail.keyframeMs = positionMs;
+
+			std::ostringstream scale;
+			scale << " -an -frames:v 1 -vf scale=" << width << ":" << height << " -pix_fmt bgr24";
+
+			std::ostringstream command;
+			command << "exec 3>&1; info=$(ffmpeg -nostdin -v quiet -noaccurate_seek -skip_frame nokey -copyts -start_at_zero";
+			command << " -ss " << (positionMs / 1000.0) << " -i " << shellQuote(path);
+			command << scale.str() << " -f rawvideo pipe:3";
+			command << scale.str() << " -f framecrc pipe:1 2>/dev/null); echo \"$info\"";
+
+			FILE* pipe = popen(command.str().c_str(), "r");
+			if (!pipe)	return thumbnail;
+
+			Mat image(height, width, CV_8UC3);
+			size_t size = width * height * 3;
+			size_t read = fread(image.data, 1, size, pipe);
+
+			// "#tb 0: num/den" gives the time base, then the first line without a # is "stream, dts, pts, ..."
+			long num = 0, den = 0, pts = 0;
+			bool found = false;
+			char line[256];
+			while (fgets(line, sizeof(line), pipe)) {
+				if (sscanf(line, "#tb 0: %ld/%ld", &num, &den) == 2)	continue;
+				if (line[0] != '#' && !found) {
+					found = sscanf(line, "%*d, %*d, %ld,", &pts) == 1;
+				}
+			}
+			pclose(pipe);
+
+			if (read != size)	return thumbnail;
+			thumbnail.image = image;
+			if (found && num > 0 && den > 0 && pts >= 0) {
+				thumbnail.keyframeMs = pts * num * 1000 / den;
+			}
+			return thumbnail;
+		};
+
+		void work() {
+			blockInterruptInThisThread();
+
+			while (true) {
+				long positionMs;
+				string path;
+				int width;
+				int height;
+				{
+					unique_lock<mutex> lock(guard);
+					wake.wait(lock, [this] { return !queue.empty(); });
+
+					positionMs = queue.front();
+					queue.pop_front();
+					inProgress.insert(positionMs);
+
+					path = videoPath;
+					width = thumbnailWidth;
+					height = thumbnailHeight;
+				}
+
+				Thumbnail thumbnail = decode(positionMs, path, width, height);
+
+				{
+					lock_guard<mutex> lock(guard);
+					inProgress.erase(positionMs);
+					cache.put(positionMs, thumbnail);
+				}
+			}
+		};
+};
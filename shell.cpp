@@ -0,0 +1,18 @@
+#pragma once
+
+#include <string>
+
+using namespace std;
+
+// Quotes a string for use in a shell command
+string shellQuote(const string& text) {
+	string quoted = "'";
+	for (char c : text) {
+		if (c == '\'') {
+			quoted += "'\\''";
+		} else {
+			quoted += c;
+		}
+	}
+	return quoted + "'";
+}
@@ -0,0 +1,195 @@
+#include <opencv2/opencv.hpp>
+#include <sys/ioctl.h>
+#include <math.h>
+
+#include "frame.cpp"
+
+using namespace cv;
+
+// Anything darker than this counts as part of a black bar
+const int LETTERBOX_THRESHOLD = 24;
+// How many points along each row or column get checked
+const int LETTERBOX_SAMPLES = 64;
+// How long to watch the video for bars, and how often to look again in case they change
+const long LETTERBOX_WINDOW_MS = 3000;
+const long LETTERBOX_RECHECK_MS = 15000;
+// Crops that differ by fewer pixels than this on every edge are treated as the same
+const int LETTERBOX_TOLERANCE = 4;
+// Bars on opposite sides can differ by this much of the frame's size and still count as the same bars
+const int LETTERBOX_SYMMETRY_PERCENT = 2;
+
+// Terminal cells are usually about twice as tall as they are wide
+const float DEFAULT_CELL_ASPECT = 2.0;
+
+// Works out how tall a cell is compared to its width, using the pixel size of the terminal when it's reported
+float detectCellAspect(const struct winsize& terminalSize) {
+	if (terminalSize.ws_xpixel > 0 && terminalSize.ws_ypixel > 0 && terminalSize.ws_col > 0 && terminalSize.ws_row > 0) {
+		float cellWidth = (float) terminalSize.ws_xpixel / terminalSize.ws_col;
+		float cellHeight = (float) terminalSize.ws_ypixel / terminalSize.ws_row;
+		return cellHeight / cellWidth;
+	}
+	return DEFAULT_CELL_ASPECT;
+}
+
+// Finds the largest area of cells with the same shape as the content, centered in the terminal
+cv::Rect fitViewport(int contentWidth, int contentHeight, int cols, int rows, float cellAspect) {
+	int width = cols;
+	int height = rows;
+
+	float fittedWidth = rows * cellAspect * contentWidth / contentHeight;
+	if (fittedWidth <= cols) {
+		width = max(1, (int) round(fittedWidth));
+	} else {
+		height = max(1, (int) round(cols * contentHeight / (contentWidth * cellAspect)));
+		height = min(height, rows);
+	}
+
+	return cv::Rect((cols - width) / 2, (rows - height) / 2, width, height);
+}
+
+// Only luma is checked, so this works the same on every frame format without converting anything
+bool isDarkRow(const FrameView& frame, int y) {
+	int step = max(1, frame.width / LETTERBOX_SAMPLES);
+	for (int x = 0; x < frame.width; x += step) {
+		if (frame.lumaAt(y, x) >= LETTERBOX_THRESHOLD)	return false;
+	}
+	return true;
+}
+
+bool isDarkColumn(const FrameView& frame, int x, int top, int bottom) {
+	int step = max(1, (bottom - top) / LETTERBOX_SAMPLES);
+	for (int y = top; y < bottom; y += step) {
+		if (frame.lumaAt(y, x) >= LETTERBOX_THRESHOLD)	return false;
+	}
+	return true;
+}
+
+// Finds the part of a frame inside any black bars. Returns an empty rect if the whole frame is dark
+cv::Rect detectContentRect(const FrameView& frame) {
+	int top = 0;
+	while (top < frame.height && isDarkRow(frame, top))	top++;
+	if (top == frame.height)	return cv::Rect();
+
+	int bottom = frame.height;
+	while (bottom > top && isDarkRow(frame, bottom - 1))	bottom--;
+
+	int left = 0;
+	while (left < frame.width && isDarkColumn(frame, left, top, bottom))	left++;
+
+	int right = frame.width;
+	while (right > left && isDarkColumn(frame, right - 1, top, bottom))	right--;
+
+	return cv::Rect(left, top, right - left, bottom - top);
+}
+
+inline bool cropsDiffer(const cv::Rect& a, const cv::Rect& b) {
+	return abs(a.x - b.x) > LETTERBOX_TOLERANCE || abs(a.y - b.y) > LETTERBOX_TOLERANCE ||
+		abs(a.x + a.width - b.x - b.width) > LETTERBOX_TOLERANCE || abs(a.y + a.height - b.y - b.height) > LETTERBOX_TOLERANCE;
+}
+
+// Whether a reaches at least as far as b on every edge, give or take the tolerance
+inline bool cropContains(const cv::Rect& a, const cv::Rect& b) {
+	return a.x <= b.x + LETTERBOX_TOLERANCE && a.y <= b.y + LETTERBOX_TOLERANCE &&
+		a.x + a.width >= b.x + b.width - LETTERBOX_TOLERANCE && a.y + a.height >= b.y + b.height - LETTERBOX_TOLERANCE;
+}
+
+// Works out how much to trim from each side of one axis, given where the content starts and ends along it
+// Baked in bars are the same size on both sides, so anything lopsided (like a subtitle over one bar) is left alone
+inline int symmetricBar(int start, int end, int size) {
+	int before = start;
+	int after = size - end;
+	int slack = max(LETTERBOX_TOLERANCE, size * LETTERBOX_SYMMETRY_PERCENT / 100);
+	if (abs(before - after) > slack)	return 0;
+	return min(before, after);
+}
+
+// Turns the content seen over a window into a crop that only removes symmetric bars
+// Real bars run across whole rows (letterboxing) or down whole columns (pillarboxing). Dark space on all four sides is
+// much more likely a logo or a lit patch of a dark scene, so that's left alone
+cv::Rect letterboxCrop(const cv::Rect& seen, int width, int height) {
+	int barX = symmetricBar(seen.x, seen.x + seen.width, width);
+	int barY = symmetricBar(seen.y, seen.y + seen.height, height);
+	if (barX > 0 && barY > 0)	return cv::Rect(0, 0, width, height);
+
+	return cv::Rect(barX, barY, width - 2 * barX, height - 2 * barY);
+}
+
+// Watches the video for black bars baked into it, so they can be cropped away
+// Dark scenes can look like bars, so the content is the union of everything seen over a few seconds, and nothing
+// changes until a whole window has been seen. Showing more of the frame happens right away, but a smaller crop has to
+// come up in two windows in a row first, so a logo or a dark shot doesn't zoom the picture in.
+class LetterboxDetector {
+	public:
+		cv::Rect crop; // The part of the frame to show, in source pixels
+
+		LetterboxDetector() {
+			this->windowStart = -1;
+			this->nextCheck = 0;
+		};
+
+		// Looks at a frame if a check is due. Returns true if the crop changed
+		bool update(const FrameView& frame, long nowMs) {
+			cv::Rect fullFrame(0, 0, frame.width, frame.height);
+
+			// A new video size, or the very first frame, starts over
+			if (crop.area() == 0 || (crop & fullFrame) != crop) {
+				crop = fullFrame;
+				pending = cv::Rect();
+				windowStart = -1;
+				nextCheck = nowMs;
+			}
+
+			if (nowMs < nextCheck)	return false;
+
+			if (windowStart < 0) {
+				windowStart = nowMs;
+				seen = cv::Rect();
+			}
+
+			cv::Rect content = detectContentRect(frame);
+			if (content.area() > 0) {
+				seen = seen.area() > 0 ? (seen | content) : content;
+			}
+
+			if (nowMs - windowStart < LETTERBOX_WINDOW_MS)	return false;
+
+			windowStart = -1;
+			nextCheck = nowMs + LETTERBOX_RECHECK_MS;
+
+			// A window that was dark the whole time says nothing about the bars
+			if (seen.area() == 0) {
+				pending = cv::Rect();
+				return false;
+			}
+
+			cv::Rect candidate = letterboxCrop(seen, frame.width, frame.height);
+			if (!cropsDiffer(candidate, crop)) {
+				pending = cv::Rect();
+				return false;
+			}
+
+			// Showing more of the frame never hides anything, so it can happen right away
+			if (cropContains(candidate, crop)) {
+				crop = candidate;
+				pending = cv::Rect();
+				return true;
+			}
+
+			// A smaller crop only counts once the next window agrees, which starts straight away
+			if (pending.area() > 0 && !cropsDiffer(pending, candidate)) {
+				crop = pending | candidate;
+				pending = cv::Rect();
+				return true;
+			}
+
+			pending = candidate;
+			nextCheck = nowMs;
+			return false;
+		};
+
+	private:
+		cv::Rect seen; // Union of the content found during the current window
+		cv::Rect pending; // A smaller crop from the last window, waiting to be confirmed by this one
+		long windowStart;
+		long nextCheck;
+};
@@ -0,0 +1,291 @@
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <errno.h>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/uio.h>
+
+#include "cells.cpp"
+#include "interrupt.cpp"
+
+using namespace std;
+
+// Waits until fd can take more output, for when it's non-blocking and full
+inline void waitWritable(int fd) {
+	struct pollfd target;
+	target.fd = fd;
+	target.events = POLLOUT;
+	target.revents = 0;
+	poll(&target, 1, -1);
+}
+
+// Writes every byte described by iov to fd, retrying on partial writes and interrupts
+// Returns false if the terminal went away
+bool writeFully(int fd, struct iovec* iov, int count) {
+	while (count > 0) {
+		ssize_t written = writev(fd, iov, count);
+		if (written < 0) {
+			if (errno == EINTR)	continue;
+			if (errno == EAGAIN) {
+				waitWritable(fd);
+				continue;
+			}
+
+			// Some file descriptors don't support writev, so fall back to plain writes
+			if (errno == EINVAL || errno == ENOSYS) {
+				for (int k = 0; k < count; k++) {
+					char* data = (char*) iov[k].iov_base;
+					size_t left = iov[k].iov_len;
+					while (left > 0) {
+						ssize_t part = write(fd, data, left);
+						if (part < 0) {
+							if (errno == EINTR)	continue;
+							if (errno == EAGAIN) {
+								waitWritable(fd);
+								continue;
+							}
+							return false;
+						}
+						data += part;
+						left -= part;
+					}
+				}
+				return true;
+			}
+			return false;
+		}
+
+		// Skip past everything that was fully written, and trim the iovec that was cut off
+		while (count > 0 && (size_t) written >= iov->iov_len) {
+			written -= iov->iov_len;
+			iov++;
+			count--;
+		}
+		if (count > 0) {
+			iov->iov_base = (char*) iov->iov_base + written;
+			iov->iov_len -= written;
+		}
+	}
+	return true;
+}
+
+// Encodes and writes frames to the terminal on its own thread, so a slow terminal never holds up decoding or input
+// The renderer draws into backBuffer() and hands it over with submit(). There are three grids: the one being drawn,
+// the one waiting to be written and the one being written. A frame still waiting when a newer one arrives is
+// replaced rather than queued, which keeps latency bounded. Since frames are encoded against what the terminal
+// actually shows, a replaced frame never leaves stale cells behind.
+// Most of the screen can stay the same for a long time (black bars around the video, for one), so frames only need
+// to fill in the region given with the last full frame; the writer keeps the rest from that full frame.
+class TerminalWriter {
+	public:
+		atomic<long> blockedMicros; // Total time spent waiting on the terminal to accept output
+		atomic<long> framesWritten;
+		atomic<long> framesDropped;
+		atomic<long> cellsDeferred; // Changed cells left for later frames by the byte budget
+
+		// Time from when each frame arrived until it was written; read and reset these with exchange()
+		atomic<long> latencyMicros;
+		atomic<long> latencyMaxMicros;
+		atomic<long> latencyCount;
+
+		TerminalWriter(int rows, int cols, int fd) :
+			slots{CellGrid(rows, cols), CellGrid(rows, cols), CellGrid(rows, cols)},
+			shown(rows, cols),
+			target(rows, cols)
+		{
+			this->fd = fd;
+			this->backIndex = 0;
+			this->pendingIndex = 1;
+			this->writingIndex = 2;
+			this->hasPending = false;
+			this->fullRequested = 1; // Nothing has been drawn yet, so the first frame has to be a full one
+			this->fullTaken = 0;
+			this->scanAll = true;
+			this->shownInited = false;
+			this->stopping = false;
+			this->blockedMicros = 0;
+			this->framesWritten = 0;
+			this->framesDropped = 0;
+			this->cellsDeferred = 0;
+			this->latencyMicros = 0;
+			this->latencyMaxMicros = 0;
+			this->latencyCount = 0;
+			this->bytesPerSecond = 0;
+			this->budgetBytes = 0;
+			for (int k = 0; k < 3; k++) {
+				this->fullFrames[k] = false;
+				this->fullGenerations[k] = 0;
+			}
+		};
+
+		// Limits output to roughly bytesPerSecond, sending the cells that look the most wrong first. 0 means no limit
+		// Must be called before start()
+		void setByteBudget(long bytesPerSecond) {
+			this->bytesPerSecond = bytesPerSecond;
+		};
+
+		void start() {
+			thread = std::thread(&TerminalWriter::run, this);
+		};
+
+		// Safe to call more than once; waits for the frame currently being written to finish
+		void stop() {
+			stopping = true;
+			wake.notify_all();
+			if (thread.joinable() && thread.get_id() != this_thread::get_id()) {
+				thread.join();
+			}
+		};
+
+		// The grid the next frame should be drawn into. Only valid until the next submit()
+		CellGrid& backBuffer() {
+			return slots[backIndex];
+		};
+
+		// Asks for the next frame to be a full one, for when something outside the current region changed
+		void requestFullFrame() {
+			fullRequested++;
+		};
+
+		// Whether the next frame has to be handed over with submitFull(), because the writer hasn't taken a full frame
+		// since one was last asked for
+		bool needsFullFrame() {
+			return fullTaken < fullRequested;
+		};
+
+		// Hands over a frame with every cell drawn. Frames after it only need to fill in region, one span per row,
+		// until the next full frame
+		void submitFull(chrono::steady_clock::time_point origin, const vector<CellSpan>& region) {
+			regions[backIndex] = region;
+			fullFrames[backIndex] = true;
+			fullGenerations[backIndex] = fullRequested;
+			handOver(origin);
+		};
+
+		// Hands over a frame that only has the region from the last full frame filled in
+		// origin is when the frame's picture arrived, for measuring latency
+		void submit(chrono::steady_clock::time_point origin) {
+			fullFrames[backIndex] = false;
+			handOver(origin);
+		};
+
+	private:
+		int fd;
+		CellGrid slots[3];
+		chrono::steady_clock::time_point origins[3];
+		int backIndex;
+		int pendingIndex;
+		int writingIndex;
+		bool hasPending;
+
+		bool fullFrames[3];
+		long fullGenerations[3]; // Which request for a full frame each full frame answers
+		vector<CellSpan> regions[3];
+		atomic<long> fullRequested;
+		atomic<long> fullTaken;
+
+		CellGrid shown; // What the terminal is currently showing, only touched by the writer thread
+		CellGrid target; // What the terminal should end up showing, put together from the frames taken
+		vector<CellSpan> region; // The part of target that frames fill in
+		bool scanAll; // Whether cells outside region may still differ from shown, after a full frame
+		bool shownInited;
+		string output;
+
+		long bytesPerSecond;
+		double budgetBytes; // Bytes that can be sent right now, refilled over time
+		chrono::steady_clock::time_point budgetRefilled;
+		vector<pair<int, int>> changedCells;
+
+		atomic<bool> stopping;
+		mutex guard;
+		condition_variable wake;
+		std::thread thread;
+
+		void handOver(chrono::steady_clock::time_point origin) {
+			{
+				lock_guard<mutex> lock(guard);
+				if (hasPending) {
+					framesDropped++;
+				}
+				origins[backIndex] = origin;
+				swap(backIndex, pendingIndex);
+				hasPending = true;
+			}
+			wake.notify_one();
+		};
+
+		void run() {
+			blockInterruptInThisThread();
+
+			budgetRefilled = chrono::steady_clock::now();
+
+			while (!stopping) {
+				{
+					unique_lock<mutex> lock(guard);
+					while (!hasPending && !stopping) {
+						wake.wait_for(lock, chrono::milliseconds(50));
+					}
+					if (stopping)	return;
+
+					swap(pendingIndex, writingIndex);
+					hasPending = false;
+				}
+
+				// Bring target up to date; only a full frame has anything outside the region worth reading
+				const CellGrid& frame = slots[writingIndex];
+				if (fullFrames[writingIndex]) {
+					target.cells = frame.cells;
+					region = regions[writingIndex];
+					fullTaken = fullGenerations[writingIndex];
+					scanAll = true;
+				} else {
+					copyCells(frame, target, region);
+				}
+				const vector<CellSpan>* diffRegion = scanAll ? nullptr : &region;
+
+				output.clear();
+				if (bytesPerSecond > 0) {
+					// The budget refills with time, but never saves up more than the time since the last frame, or a tenth
+					// of a second for fast sources, so slow sources can still use the whole rate without bursting
+					auto now = chrono::steady_clock::now();
+					double seconds = chrono::duration<double>(now - budgetRefilled).count();
+					budgetBytes = min(budgetBytes + bytesPerSecond * seconds, bytesPerSecond * max(seconds, 0.1));
+					budgetRefilled = now;
+
+					// What's on the terminal isn't known yet, so start from a blank screen to match shown
+					if (!shownInited)	output += "\033[0m\033[H\033[2J";
+
+					cellsDeferred = encodeCellsBudgeted(target, shown, (long) budgetBytes, changedCells, output, diffRegion);
+					budgetBytes -= output.size();
+
+					// Cells outside the region may have been left for later, so keep looking at them until they're sent
+					if (scanAll)	scanAll = !cellsEqualOutside(target, shown, region);
+				} else {
+					encodeCells(target, shown, !shownInited, output, diffRegion);
+					scanAll = false;
+				}
+				shownInited = true;
+
+				struct iovec iov;
+				iov.iov_base = (void*) output.data();
+				iov.iov_len = output.size();
+
+				auto before = chrono::steady_clock::now();
+				bool ok = writeFully(fd, &iov, 1);
+				auto after = chrono::steady_clock::now();
+
+				blockedMicros += chrono::duration_cast<chrono::microseconds>(after - before).count();
+
+				long latency = chrono::duration_cast<chrono::microseconds>(after - origins[writingIndex]).count();
+				latencyMicros += latency;
+				latencyCount++;
+				if (latency > latencyMaxMicros)	latencyMaxMicros = latency;
+				framesWritten++;
+
+				if (!ok)	return;
+			}
+		};
+};
@@ -0,0 +1,102 @@
+#pragma once
+
+#include <string>
+#include <errno.h>
+#include <stdio.h>
+#include <unistd.h>
+
+#include "interrupt.cpp"
+
+using namespace std;
+
+// Reads exactly length bytes, returning false if the stream ended first
+bool readExact(int fd, uint8_t* data, size_t length) {
+	while (length > 0) {
+		ssize_t part = read(fd, data, length);
+		if (part < 0) {
+			// Give up if the interruption was Ctrl+C, so waiting on an idle pipe can't hang the program
+			if (errno == EINTR && exitRequested)	return false;
+			if (errno == EINTR || errno == EAGAIN)	continue;
+			return false;
+		}
+		if (part == 0)	return false;
+
+		data += part;
+		length -= part;
+	}
+	return true;
+}
+
+// Reads up to a newline, one byte at a time so nothing past it gets consumed
+bool readLine(int fd, string& line) {
+	line.clear();
+	char c;
+	while (true) {
+		ssize_t part = read(fd, &c, 1);
+		if (part < 0) {
+			// Give up if the interruption was Ctrl+C, so waiting on an idle pipe can't hang the program
+			if (errno == EINTR && exitRequested)	return false;
+			if (errno == EINTR || errno == EAGAIN)	continue;
+			return false;
+		}
+		if (part == 0)	return false;
+		if (c == '\n')	return true;
+
+		line += c;
+	}
+}
+
+// What a y4m stream header says about its frames; the frame rate is left at 0/0 if it isn't given
+struct Y4MHeader {
+	int width = 0;
+	int height = 0;
+	int fpsNumerator = 0;
+	int fpsDenominator = 0;
+};
+
+// The 4:2:0 colorspaces only differ in where the chroma samples sit, which doesn't matter here
+// Higher bit depths like C420p10 take two bytes per sample, so they're left out
+bool isEightBit420(const string& token) {
+	return token == "C420" || token == "C420jpeg" || token == "C420paldv" || token == "C420mpeg2";
+}
+
+// Parses the first line of a y4m stream (already checked to start with YUV4MPEG2)
+// Each frame after it is a FRAME line followed by the Y plane, then the U and V planes at a quarter of its size
+bool parseY4MHeader(const string& line, Y4MHeader& header, string& error) {
+	size_t position = line.find(' ');
+	while (position != string::npos) {
+		size_t end = line.find(' ', position + 1);
+		string token = line.substr(position + 1, end == string::npos ? string::npos : end - position - 1);
+		position = end;
+
+		if (token.empty())	continue;
+
+		if (token[0] == 'W') {
+			if (sscanf(token.c_str() + 1, "%d", &header.width) != 1) {
+				error = "Invalid y4m frame width: " + token;
+				return false;
+			}
+		} else if (token[0] == 'H') {
+			if (sscanf(token.c_str() + 1, "%d", &header.height) != 1) {
+				error = "Invalid y4m frame height: " + token;
+				return false;
+			}
+		} else if (token[0] == 'F') {
+			int numerator = 0;
+			int denominator = 1;
+			if (sscanf(token.c_str() + 1, "%d:%d", &numerator, &denominator) == 2 && denominator > 0 && numerator > 0) {
+				header.fpsNumerator = numerator;
+				header.fpsDenominator = denominator;
+			}
+		} else if (token[0] == 'C' && !isEightBit420(token)) {
+			error = "Only 8-bit 4:2:0 y4m streams are supported, got " + token;
+			return false;
+		}
+	}
+
+	if (header.width <= 0 || header.height <= 0 || header.width % 2 != 0 || header.height % 2 != 0) {
+		error = "Invalid y4m frame size";
+		return false;
+	}
+	return true;
+}